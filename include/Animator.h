@@ -2,6 +2,7 @@
 #include <memory>
 #include "Animation.h"
 #include "RotationAnimation.h"
+#include "SlerpAnimation.h"
 
 class Animator {
 private:
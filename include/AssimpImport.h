@@ -1,10 +1,70 @@
 #pragma once
 #include "Object3D.h"
+#include "ModelData.h"
+#include "Task.h"
+#include "TextureDecoder.h"
 #include <assimp/scene.h>
 #include <unordered_map>
 #include <filesystem>
 
-Object3D assimpLoad(const std::string& path, bool flipUVCoords);
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
\ No newline at end of file
+/**
+ * @brief Processing applied to a model's meshes when it is imported.
+ */
+struct ImportOptions {
+	// The triangle count of each level of detail to generate, as a fraction of the full mesh's,
+	// from finest to coarsest. Empty to generate none.
+	std::vector<float> lodTargets = { 0.5f, 0.25f, 0.1f };
+	// Whether to merge the meshes of static subtrees into one mesh per texture set, to cut draw
+	// calls. This removes the merged nodes from the hierarchy; see mergeStaticMeshes.
+	bool mergeStaticMeshes = false;
+	// Whether the model's meshes hide others from the OcclusionBuffer. Only large, solid models
+	// make good occluders. This only affects building the model, not its cooked data.
+	bool occluder = false;
+
+	/**
+	 * @brief Hashes the options, so that a model cooked with different options is re-imported.
+	 */
+	uint64_t hash() const;
+};
+
+Object3D assimpLoad(const std::string& path, bool flipUVCoords, const ImportOptions& options = {});
+
+/**
+ * @brief Loads a model without blocking the GL thread: file I/O, Assimp import, and texture
+ * decoding happen on worker threads, and the coroutine resumes on the GL thread only to create
+ * the model's buffers and textures. The render loop must drain glThreadQueue() for it to finish.
+ */
+Task<Object3D> loadModelAsync(std::filesystem::path path, bool flipUVCoords, ImportOptions options = {});
+
+/**
+ * @brief Loads the processed geometry, hierarchy, and texture references of a model. Uses the
+ * model's cooked cache if it is up to date; otherwise imports the model with Assimp and cooks the
+ * result for next time.
+ */
+ModelData loadModelData(const std::filesystem::path& path, bool flipUVCoords, const ImportOptions& options);
+
+/**
+ * @brief Imports a model with Assimp, using the given post-processing flags.
+ */
+ModelData assimpImport(const std::filesystem::path& path, uint32_t importFlags, const ImportOptions& options);
+
+/**
+ * @brief Uploads a model's meshes and textures to the GPU and builds its object hierarchy.
+ * @param modelPath the path the model was loaded from, which texture names are relative to.
+ * @param occluder whether to designate the model's meshes as occluders; see buildOccluder.
+ */
+Object3D buildObject(const ModelData& model, const std::filesystem::path& modelPath, bool occluder = false);
+
+/**
+ * @brief The occluder triangles of a mesh: its coarsest level of detail, over only the vertices
+ * that level uses.
+ */
+OccluderMesh buildOccluder(const MeshData& mesh);
+
+/**
+ * @brief Every texture referenced by a model's meshes, without duplicates: texture files next to
+ * the model, and textures embedded in it.
+ */
+std::vector<ImageSource> modelTextureSources(const ModelData& model, const std::filesystem::path& modelPath);
+
+NodeData processAssimpNode(aiNode* node, const aiScene* scene);
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * @brief A thread-safe FIFO queue with a fixed capacity. Producers block while the queue is full
+ * and consumers block while it is empty, so a fast producer can never get more than `capacity`
+ * items ahead of a slow consumer.
+ */
+template <typename T>
+class BoundedQueue {
+	std::deque<T> m_items;
+	size_t m_capacity;
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+
+public:
+	explicit BoundedQueue(size_t capacity) : m_capacity(capacity) {
+	}
+
+	/**
+	 * @brief Adds an item to the back of the queue, waiting for space if the queue is full.
+	 */
+	void push(T item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+		m_items.push_back(std::move(item));
+		lock.unlock();
+		m_notEmpty.notify_one();
+	}
+
+	/**
+	 * @brief Removes the item at the front of the queue, waiting for one if the queue is empty.
+	 */
+	T pop() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] { return !m_items.empty(); });
+		T item = std::move(m_items.front());
+		m_items.pop_front();
+		lock.unlock();
+		m_notFull.notify_one();
+		return item;
+	}
+
+	/**
+	 * @brief Removes the item at the front of the queue, if there is one, without waiting.
+	 */
+	std::optional<T> tryPop() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_items.empty()) {
+			return std::nullopt;
+		}
+		std::optional<T> item(std::move(m_items.front()));
+		m_items.pop_front();
+		lock.unlock();
+		m_notFull.notify_one();
+		return item;
+	}
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <glm/ext.hpp>
+
+/**
+ * @brief An axis-aligned box. A default-constructed box is empty: it contains no points, and
+ * adding anything to it gives that thing's box.
+ */
+struct BoundingBox {
+	glm::vec3 minimum;
+	glm::vec3 maximum;
+
+	BoundingBox();
+	BoundingBox(const glm::vec3& minimum, const glm::vec3& maximum);
+
+	bool isEmpty() const;
+	void add(const glm::vec3& point);
+	void add(const BoundingBox& box);
+
+	/**
+	 * @brief The smallest axis-aligned box around this box after transforming it by a matrix.
+	 */
+	BoundingBox transformed(const glm::mat4& matrix) const;
+};
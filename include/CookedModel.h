@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include "ModelData.h"
+
+/**
+ * @brief Identifies the exact inputs a cooked model was produced from. A cooked model is only used
+ * if its key matches the key of the source model it stands in for.
+ */
+struct CookedModelKey {
+	// FNV-1a hash of the source model file's contents.
+	uint64_t sourceHash;
+	// The Assimp post-processing flags the source was imported with.
+	uint32_t importFlags;
+	// A hash of the ImportOptions that processed the imported meshes.
+	uint64_t optionsHash;
+};
+
+/**
+ * @brief The path of the cooked model that sits next to a source model, e.g. "boat.fbx.cooked".
+ */
+std::filesystem::path cookedModelPath(const std::filesystem::path& modelPath);
+
+/**
+ * @brief Computes the key of a source model by hashing its contents.
+ */
+CookedModelKey cookedModelKey(const std::filesystem::path& modelPath, uint32_t importFlags, uint64_t optionsHash);
+
+/**
+ * @brief Memory-maps a cooked model and reads it back into a ModelData.
+ * @return nothing if the file does not exist, is corrupt, or was cooked from a different key or
+ * by a different version of the cooker.
+ */
+std::optional<ModelData> loadCookedModel(const std::filesystem::path& cookedPath, const CookedModelKey& key);
+
+/**
+ * @brief Writes a ModelData to a cooked model file. The file is written to a temporary path and
+ * renamed into place, so a crash never leaves a truncated cooked model behind.
+ */
+void saveCookedModel(const std::filesystem::path& cookedPath, const CookedModelKey& key, const ModelData& model);
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "ShaderProgram.h"
+
+/**
+ * @brief How many GL state calls went to the driver, and how many were skipped because they
+ * would not have changed anything.
+ */
+struct GLStateStats {
+	uint32_t issued = 0;
+	uint32_t elided = 0;
+};
+
+/**
+ * @brief A shadow copy of the GL binding state that the renderer changes: the current program and
+ * vertex array, the 2D texture bound to each texture unit, and the value of each program's
+ * sampler uniforms. Calls that would set state to the value it already has are skipped.
+ *
+ * The cache only stays correct if every change to that state goes through it; code that changes
+ * it directly must call invalidate() afterwards. Must only be used on the GL thread.
+ */
+class GLStateCache {
+	// Stands for a binding whose value is unknown, so the next bind can't be skipped.
+	static const uint32_t UNKNOWN = UINT32_MAX;
+
+	uint32_t m_program;
+	uint32_t m_vertexArray;
+	uint32_t m_activeUnit;
+	// The texture bound to GL_TEXTURE_2D on each unit.
+	std::vector<uint32_t> m_textures;
+	// The texture unit each sampler uniform of each program is set to, by program and location.
+	std::unordered_map<uint32_t, std::unordered_map<int32_t, int32_t>> m_samplers;
+	GLStateStats m_stats;
+
+	GLStateCache();
+
+	// Counts a call, returning whether it must be issued.
+	bool changes(uint32_t& current, uint32_t value);
+
+public:
+	static GLStateCache& instance();
+
+	void useProgram(uint32_t program);
+	void bindVertexArray(uint32_t vertexArray);
+	void bindTexture(uint32_t unit, uint32_t texture);
+
+	/**
+	 * @brief Sets a sampler uniform of the current program to a texture unit.
+	 */
+	void setSampler(ShaderProgram& program, UniformHandle sampler, int32_t unit);
+
+	/**
+	 * @brief Forgets a texture that is about to be deleted. GL unbinds a deleted texture from every
+	 * unit, so the units it was bound to now have nothing bound.
+	 */
+	void textureDeleted(uint32_t texture);
+
+	/**
+	 * @brief Forgets all cached state, after GL state was changed without going through the cache.
+	 */
+	void invalidate();
+
+	/**
+	 * @brief The calls issued and elided since the last resetStats().
+	 */
+	const GLStateStats& stats() const;
+	void resetStats();
+};
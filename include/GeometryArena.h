@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "VertexFormat.h"
+
+/**
+ * @brief Hands out ranges of a fixed-size space, first fit, from a list of free blocks. Freed
+ * ranges are merged with the free blocks on either side of them.
+ */
+class FreeListAllocator {
+	struct Block {
+		size_t offset;
+		size_t size;
+	};
+
+	// The free blocks, sorted by offset, never adjacent to each other.
+	std::vector<Block> m_free;
+	size_t m_capacity;
+	size_t m_used;
+
+public:
+	explicit FreeListAllocator(size_t capacity);
+
+	/**
+	 * @brief Allocates a range of the given size, starting at a multiple of the given alignment.
+	 * @return the start of the range, or nothing if no free block is large enough.
+	 */
+	std::optional<size_t> allocate(size_t size, size_t alignment = 1);
+	void free(size_t offset, size_t size);
+
+	/**
+	 * @brief Extends the space; the new room is free.
+	 */
+	void grow(size_t newCapacity);
+
+	size_t capacity() const;
+	size_t used() const;
+	size_t freeBlockCount() const;
+	size_t largestFreeBlock() const;
+};
+
+/**
+ * @brief A mesh's share of the GeometryArena. The ranges are returned to the arena when the last
+ * reference to the allocation is released.
+ */
+struct GeometryAllocation {
+	VertexFormat format;
+	// The mesh's vertices are [firstVertex, firstVertex + vertexCount) of its format's vertex buffer.
+	size_t firstVertex;
+	size_t vertexCount;
+	// The mesh's indices are the bytes [indexOffset, indexOffset + indexBytes) of the index buffer.
+	size_t indexOffset;
+	size_t indexBytes;
+
+	~GeometryAllocation();
+};
+
+/**
+ * @brief Usage of one of the arena's buffers.
+ */
+struct GeometryBufferStats {
+	const char* name;
+	size_t capacityBytes;
+	size_t usedBytes;
+	size_t freeBlocks;
+	size_t largestFreeBlockBytes;
+
+	// The fraction of the buffer holding live data.
+	float utilization() const;
+	// The fraction of the free space outside the largest free block, i.e. unusable for an
+	// allocation as big as all the free space combined.
+	float fragmentation() const;
+};
+
+/**
+ * @brief Holds the vertices and indices of every static mesh in a few large GPU buffers: one vertex
+ * buffer per vertex format, and one index buffer for all of them. Meshes with the same vertex
+ * format share one vertex array object (two, if any are drawn indirectly), and are drawn with a
+ * base vertex that locates their vertices in the shared buffer. Buffers that fill up are replaced
+ * with larger ones, keeping every allocation at the same offset.
+ *
+ * The arena must only be used on the GL thread. Its buffers are never deleted; they live as long
+ * as the GL context.
+ */
+class GeometryArena {
+	struct VertexPool {
+		uint32_t vao;
+		// The vertex array for indirect draws, or 0 until one is first needed.
+		uint32_t indirectVao;
+		uint32_t vbo;
+		// Allocates in units of whole vertices.
+		FreeListAllocator allocator;
+	};
+
+	std::unordered_map<VertexFormat, VertexPool> m_pools;
+	uint32_t m_ebo;
+	// Allocates in bytes.
+	FreeListAllocator m_indices;
+
+	GeometryArena();
+
+	VertexPool& pool(VertexFormat format);
+	// Moves a buffer's contents into a new, larger buffer, and returns the new buffer.
+	static uint32_t resizeBuffer(uint32_t buffer, size_t oldSize, size_t newSize);
+	void growVertices(VertexFormat format, VertexPool& pool, size_t minimumVertices);
+	void growIndices(size_t minimumBytes);
+
+public:
+	static GeometryArena& instance();
+
+	/**
+	 * @brief Copies a mesh's encoded vertices and its indices into the arena.
+	 * @param vertices vertexCount vertices, already encoded in the given format.
+	 */
+	std::shared_ptr<const GeometryAllocation> allocate(VertexFormat format, const void* vertices, size_t vertexCount,
+		const void* indices, size_t indexBytes);
+
+	/**
+	 * @brief Returns an allocation's ranges to the free lists. Called when the allocation is released.
+	 */
+	void free(const GeometryAllocation& allocation);
+
+	/**
+	 * @brief The vertex array object that draws meshes of the given vertex format.
+	 */
+	uint32_t vertexArray(VertexFormat format);
+	/**
+	 * @brief The vertex array object that draws meshes of the given vertex format with an
+	 * IndirectRenderer. It reads the draw index attribute instead of the instance attributes.
+	 */
+	uint32_t indirectVertexArray(VertexFormat format);
+
+	std::vector<GeometryBufferStats> stats() const;
+	void printStats() const;
+};
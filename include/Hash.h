@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief 64-bit FNV-1a hash of a block of memory. Pass a previous result as the seed to hash
+ * several blocks as if they were one.
+ */
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+	auto bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+#include "RenderView.h"
+#include "ShaderProgram.h"
+
+class Mesh3D;
+
+// The attribute location of the index of a draw's entry in the per-draw storage buffer.
+const uint32_t DRAW_INDEX_LOCATION = 8;
+// The binding point of the per-draw storage buffer.
+const uint32_t INDIRECT_DRAWS_BINDING = 0;
+
+/**
+ * @brief One command of glMultiDrawElementsIndirect, in the layout GL reads from the draw
+ * indirect buffer.
+ */
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+/**
+ * @brief The per-draw state of an indirect draw, in the std430 layout of the Draw struct in
+ * texture_indirect.vert.
+ */
+struct IndirectDrawData {
+	glm::mat4 model;
+	glm::vec4 material;
+	// The mesh's position dequantization; only the xyz components are used.
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+};
+
+/**
+ * @brief A vertex buffer holding 0, 1, 2, ..., read once per instance at DRAW_INDEX_LOCATION. A
+ * command's base instance offsets where the reading starts, so each instance of each command
+ * reads the index of its own entry in the per-draw storage buffer.
+ */
+class DrawIndexBuffer {
+	uint32_t m_buffer;
+	uint32_t m_count;
+
+	DrawIndexBuffer();
+
+public:
+	/**
+	 * @brief The shared buffer, created on first use. Must only be used on the GL thread.
+	 */
+	static DrawIndexBuffer& instance();
+
+	/**
+	 * @brief Points the draw index attribute of the currently bound vertex array at the buffer.
+	 */
+	void attach() const;
+
+	/**
+	 * @brief Grows the buffer to hold at least the given number of indices.
+	 */
+	void reserve(uint32_t count);
+};
+
+/**
+ * @brief Collects the draws of a whole scene, and submits them with one glMultiDrawElementsIndirect
+ * per vertex array, index type, and texture set. Each draw's model matrix, material, and position
+ * dequantization go in a shader storage buffer instead of uniforms, so the CPU cost of submitting
+ * does not grow with the number of meshes. Consecutive draws of the same mesh and level of detail
+ * become one instanced command.
+ *
+ * Requires OpenGL 4.3, and a program that reads its per-draw state like texture_indirect.vert.
+ */
+class IndirectRenderer {
+	struct Bucket {
+		uint32_t vao;
+		uint32_t indexType;
+		std::vector<uint32_t> textureIds;
+		// A mesh whose textures the bucket binds; every mesh in the bucket has the same ones.
+		const Mesh3D* textureSource;
+		std::vector<DrawElementsIndirectCommand> commands;
+		// The mesh and level of detail of the last command.
+		const Mesh3D* lastMesh;
+		size_t lastLod;
+	};
+
+	std::vector<Bucket> m_buckets;
+	std::vector<IndirectDrawData> m_draws;
+	// Every bucket's commands, laid out one bucket after another for uploading.
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	uint32_t m_commandBuffer;
+	uint32_t m_drawBuffer;
+
+	Bucket& bucket(const Mesh3D& mesh);
+
+public:
+	/**
+	 * @brief Whether the GL context supports multi-draw-indirect and shader storage buffers.
+	 */
+	static bool supported();
+
+	IndirectRenderer();
+	~IndirectRenderer();
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	/**
+	 * @brief Queues a draw of a mesh's level of detail with the given model matrix and material.
+	 */
+	void add(const Mesh3D& mesh, size_t lod, const glm::mat4& model, const glm::vec4& material);
+
+	/**
+	 * @brief Draws everything queued since the last flush, and empties the queue.
+	 * @param view where to count the draws, or null.
+	 */
+	void flush(ShaderProgram& program, const RenderView* view);
+};
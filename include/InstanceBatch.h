@@ -0,0 +1,76 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+#include "RenderView.h"
+#include "ShaderProgram.h"
+
+class Mesh3D;
+
+// The first of the four attribute locations that hold an instance's mat4 model matrix.
+const uint32_t INSTANCE_MODEL_LOCATION = 3;
+// The attribute location that holds an instance's material parameters.
+const uint32_t INSTANCE_MATERIAL_LOCATION = 7;
+
+/**
+ * @brief The per-instance attributes of an instanced draw.
+ */
+struct InstanceData {
+	glm::mat4 model;
+	// k_a, k_d, k_s, shininess, as in the "material" uniform of a draw that isn't instanced.
+	glm::vec4 material;
+};
+
+/**
+ * @brief A vertex buffer of per-instance model matrices and materials, shared by every mesh's vertex array. Its
+ * contents are replaced before each instanced draw.
+ */
+class InstanceBuffer {
+	uint32_t m_buffer;
+
+	InstanceBuffer();
+
+public:
+	/**
+	 * @brief The shared buffer, created on first use. Must only be used on the GL thread.
+	 */
+	static InstanceBuffer& instance();
+
+	/**
+	 * @brief Points the instance attributes of the currently bound vertex array at the buffer,
+	 * advancing once per instance.
+	 */
+	void attach() const;
+
+	/**
+	 * @brief Replaces the buffer's contents, orphaning the old storage so the upload never waits
+	 * for draws that are still reading it. There must be at least one instance.
+	 */
+	void upload(const std::vector<InstanceData>& instances) const;
+};
+
+/**
+ * @brief Collects draws of meshes that several objects share during one traversal of a scene, and
+ * issues each mesh (at each level of detail) as a single instanced draw.
+ */
+class InstanceBatcher {
+	struct Batch {
+		const Mesh3D* mesh;
+		size_t lod;
+		std::vector<InstanceData> instances;
+	};
+
+	std::vector<Batch> m_batches;
+
+public:
+	/**
+	 * @brief Queues a draw of a mesh's level of detail with the given model matrix and material.
+	 */
+	void add(const Mesh3D& mesh, size_t lod, const glm::mat4& model, const glm::vec4& material);
+
+	/**
+	 * @brief Draws every queued batch and empties the queue.
+	 * @param view where to count the draws, or null.
+	 */
+	void flush(ShaderProgram& program, const RenderView* view);
+};
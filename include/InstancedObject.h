@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Object3D.h"
+
+/**
+ * @brief Draws many copies of one object hierarchy, each placed by its own transform and with its
+ * own material, using one instanced draw per mesh of the hierarchy instead of one draw per mesh
+ * per copy.
+ *
+ * The hierarchy is flattened when the InstancedObject is constructed; later changes to the
+ * prototype object are not seen. Programs must read the per-instance attributes, as the shaders
+ * with an "instanced" uniform or the *_instanced.vert shaders do.
+ */
+class InstancedObject {
+	struct Part {
+		std::shared_ptr<Mesh3D> mesh;
+		// The mesh's transformation relative to the hierarchy's root, including the root's own.
+		glm::mat4 transform;
+		// The attributes of every instance, with the part's transform applied.
+		mutable std::vector<InstanceData> instances;
+	};
+
+	std::vector<Part> m_parts;
+	std::vector<InstanceData> m_instances;
+	// Whether the parts' instance attributes must be rebuilt from m_instances.
+	mutable bool m_dirty;
+
+	void addParts(const Object3D& object, const glm::mat4& parentMatrix);
+	void updateParts() const;
+
+public:
+	/**
+	 * @brief Flattens the meshes of an object and its descendants into the parts drawn for each
+	 * instance. The meshes are shared with the prototype.
+	 */
+	explicit InstancedObject(const Object3D& prototype);
+
+	/**
+	 * @brief Adds a copy of the hierarchy, returning its index.
+	 * @param transform the copy's local->world matrix, applied after the prototype's own transform.
+	 */
+	size_t addInstance(const glm::mat4& transform, const glm::vec4& material = glm::vec4(0.1, 1.0, 0.3, 4));
+	size_t instanceCount() const;
+	void clearInstances();
+
+	const glm::mat4& getTransform(size_t index) const;
+	const glm::vec4& getMaterial(size_t index) const;
+	void setTransform(size_t index, const glm::mat4& transform);
+	void setMaterial(size_t index, const glm::vec4& material);
+
+	/**
+	 * @brief Renders every instance of the full meshes, with one draw call per part.
+	 */
+	void render(ShaderProgram& program) const;
+	/**
+	 * @brief Renders only the instances of each part that may be visible in the view, grouped by
+	 * their level of detail, with one draw call per part and level.
+	 */
+	void render(ShaderProgram& program, const RenderView& view) const;
+	/**
+	 * @brief Queues the instances of each part that may be visible in the view. The draws are
+	 * issued by the IndirectRenderer's next flush.
+	 */
+	void render(const RenderView& view, IndirectRenderer& indirect) const;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+/**
+ * @brief A read-only memory mapping of an entire file. The file's contents are paged in by the OS
+ * on first access, instead of being copied through a stream buffer.
+ */
+class MappedFile {
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+
+	void close();
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	/**
+	 * @brief Maps the given file, replacing any previous mapping.
+	 * @return false if the file does not exist or could not be mapped.
+	 */
+	bool open(const std::filesystem::path& path);
+
+	const unsigned char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
@@ -1,10 +1,18 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <glad/glad.h>
+#include <span>
 #include <vector>
 
 #include "Texture.h"
 #include "ShaderProgram.h"
+#include "VertexFormat.h"
+#include "RenderView.h"
+#include "Meshlet.h"
+#include "GeometryArena.h"
+#include "InstanceBatch.h"
+#include "IndirectRenderer.h"
+#include "OcclusionBuffer.h"
 struct Vertex3D {
 	float x;
 	float y;
@@ -22,12 +30,70 @@ struct Vertex3D {
 		x(px), y(py), z(pz), nx(normX), ny(normY), nz(normZ), u(texU), v(texV) {}
 };
 
+/**
+ * @brief A simplified version of a mesh: a triangle list over the same vertices as the full mesh.
+ */
+struct MeshLod {
+	std::vector<uint32_t> faces;
+	// The largest distance, in the mesh's local space, between this level and the full mesh.
+	float error;
+};
+
 class Mesh3D {
 private:
+	/**
+	 * @brief Where one level of detail's indices sit in the mesh's element buffer.
+	 */
+	struct LodRange {
+		// Byte offset of the level's first index in the shared index buffer.
+		size_t offset;
+		uint32_t indexCount;
+		float error;
+	};
+
+
+	// The mesh's vertices and indices in the shared geometry buffers, and the vertex array shared
+	// by every mesh of its vertex format. The mesh's vertices start at m_baseVertex in that array.
+	std::shared_ptr<const GeometryAllocation> m_geometry;
 	uint32_t m_vao;
+	GLint m_baseVertex;
 	std::vector<Texture> m_textures;
 	uint32_t m_vertexCount;
 	uint32_t m_faceCount;
+	// GL_UNSIGNED_SHORT if the mesh has few enough vertices for 16-bit indices, else GL_UNSIGNED_INT.
+	uint32_t m_indexType;
+	// The full mesh, followed by its simplified levels of detail from finest to coarsest. All of
+	// them share the vertex buffer; their indices are concatenated in the element buffer.
+	std::vector<LodRange> m_lods;
+	// A box and a sphere around the mesh's vertices, in its local space.
+	BoundingBox m_bounds;
+	glm::vec3 m_boundsCenter;
+	float m_boundsRadius;
+	// The full mesh's faces, partitioned into independently cullable clusters. Empty if the mesh
+	// is too small to be worth partitioning.
+	std::vector<Meshlet> m_meshlets;
+	// Scratch space for the ranges of visible meshlets, reused between frames.
+	mutable std::vector<GLsizei> m_drawCounts;
+	mutable std::vector<const void*> m_drawOffsets;
+	mutable std::vector<GLint> m_drawBaseVertices;
+	mutable std::vector<glm::mat4> m_instanceModels;
+	// How many nodes of the mesh's model draw it. A mesh drawn by several is drawn instanced.
+	uint32_t m_nodeCount;
+	// A coarse copy of the mesh's triangles on the CPU, if the mesh hides others from the
+	// OcclusionBuffer.
+	std::shared_ptr<const OccluderMesh> m_occluder;
+
+	// How the vertices are stored on the GPU, and how to dequantize their positions.
+	VertexFormat m_format;
+	PositionQuantization m_quantization;
+
+	// The sampler uniform of each texture, and the position dequantization uniforms, resolved
+	// against the program identified by m_uniformProgram.
+	mutable std::vector<UniformHandle> m_samplerUniforms;
+	mutable UniformHandle m_positionScaleUniform;
+	mutable UniformHandle m_positionOffsetUniform;
+	mutable UniformHandle m_instancedUniform;
+	mutable uint32_t m_uniformProgram;
 
 public:
 	Mesh3D() = delete;
@@ -41,8 +107,14 @@ public:
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 		Texture texture);
 
+	/**
+	 * @brief Constructs a Mesh3D, storing its vertices on the GPU in the given format.
+	 * @param lods simplified versions of the mesh over the same vertices, from finest to coarsest.
+	 * @param meshlets a partition of the faces into clusters, as built by buildMeshlets.
+	 */
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
-		std::vector<Texture>&& textures);
+		std::vector<Texture>&& textures, VertexFormat format = VertexFormat::Float32,
+		std::vector<MeshLod>&& lods = {}, std::vector<Meshlet>&& meshlets = {});
 
 	void addTexture(Texture texture);
 
@@ -58,5 +130,101 @@ public:
 	 * @param proj the view->clip projection matrix.
 	*/
 	void render(ShaderProgram& program) const;
+
+	/**
+	 * @brief Renders the coarsest level of detail whose error, projected on screen, is within the
+	 * view's tolerance. Nothing is drawn if the mesh is outside the view frustum; when the full
+	 * mesh is drawn, only its meshlets that are inside the frustum and not backfacing are.
+	 * @param model the local->world matrix the mesh is rendered with.
+	 */
+	void render(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const;
+	/**
+	 * @brief Renders like render(program, view, model), for a caller that has already found the
+	 * mesh to be inView.
+	 */
+	void renderInView(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const;
+
+	/**
+	 * @brief The level of detail that render(program, view, model) would draw; 0 is the full mesh.
+	 */
+	size_t selectLod(const RenderView& view, const glm::mat4& model) const;
+
+	/**
+	 * @brief A box around the mesh's vertices, in its local space.
+	 */
+	const BoundingBox& bounds() const;
+
+	size_t lodCount() const;
+	uint32_t triangleCount(size_t lod) const;
+
+	/**
+	 * @brief Whether the mesh may be visible in the view when rendered with the given model matrix.
+	 */
+	bool inView(const RenderView& view, const glm::mat4& model) const;
+
+	/**
+	 * @brief Renders one level of detail of the mesh once per instance, in a single draw call.
+	 * Each instance is placed by its own model matrix, rather than the program's transform uniforms.
+	 */
+	void renderInstanced(ShaderProgram& program, size_t lod, const std::vector<InstanceData>& instances) const;
+	/**
+	 * @brief Renders one level of detail of the mesh once per instance. When the full mesh is
+	 * drawn, only its meshlets that may be visible in at least one instance are.
+	 */
+	void renderInstanced(ShaderProgram& program, const RenderView& view, size_t lod,
+		const std::vector<InstanceData>& instances) const;
+
+	/**
+	 * @brief Records how many nodes draw the mesh, as counted when their hierarchy was built.
+	 */
+	void setNodeCount(uint32_t count);
+	/**
+	 * @brief Whether several nodes draw the mesh, so that their draws should be batched into
+	 * instanced draws.
+	 */
+	bool shared() const;
+
+	/**
+	 * @brief The indirect draw command for one instance of a level of detail, with a base
+	 * instance of 0.
+	 */
+	DrawElementsIndirectCommand indirectCommand(size_t lod) const;
+	/**
+	 * @brief The vertex array that draws the mesh, shared with every mesh of its vertex format.
+	 */
+	uint32_t vertexArray() const;
+	/**
+	 * @brief The vertex array that draws the mesh with an IndirectRenderer.
+	 */
+	uint32_t indirectVertexArray() const;
+	uint32_t indexType() const;
+	const std::vector<Texture>& getTextures() const;
+	const PositionQuantization& quantization() const;
+
+	/**
+	 * @brief Designates the mesh as an occluder, rasterized into the OcclusionBuffer as the given
+	 * triangles in its local space; nullptr to stop. Whatever the triangles cover that the mesh
+	 * doesn't may be wrongly hidden, so they should stay close to the mesh.
+	 */
+	void setOccluder(std::shared_ptr<const OccluderMesh> occluder);
+	const std::shared_ptr<const OccluderMesh>& occluder() const;
+
+	/**
+	 * @brief Binds the mesh's textures, and points the program's samplers at them.
+	 */
+	void bindTextures(ShaderProgram& program) const;
+
+private:
+	// Resolves the mesh's uniforms against the program, if it hasn't already.
+	void resolveUniforms(ShaderProgram& program) const;
+	// Sets the mesh's uniforms and binds its vertex array and textures.
+	void bind(ShaderProgram& program) const;
+	void renderLod(ShaderProgram& program, size_t lod) const;
+	void renderMeshlets(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const;
+	// Collects the index ranges of the meshlets that may be visible with any of the model matrices
+	// into m_drawCounts, m_drawOffsets, and m_drawBaseVertices.
+	void cullMeshlets(const RenderView& view, std::span<const glm::mat4> models) const;
+	// The largest factor by which a model matrix scales any axis.
+	static float maxScale(const glm::mat4& model);
 	
 };
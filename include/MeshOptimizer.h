@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Mesh3D.h"
+
+/**
+ * @brief The number of entries in the post-transform vertex cache we optimize for and simulate.
+ */
+const size_t VERTEX_CACHE_SIZE = 16;
+
+/**
+ * @brief How well an index buffer uses a simulated FIFO post-transform vertex cache.
+ */
+struct VertexCacheStats {
+	// Average cache miss ratio: vertex shader invocations per triangle. 3 is the worst case,
+	// and about 0.5 the best possible for a regular grid.
+	float acmr;
+	// Average transform to vertex ratio: vertex shader invocations per distinct vertex. 1 is ideal.
+	float atvr;
+};
+
+/**
+ * @brief Simulates a FIFO vertex cache of VERTEX_CACHE_SIZE entries over a triangle list.
+ */
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount);
+
+/**
+ * @brief Reorders the triangles of a triangle list for post-transform vertex cache locality,
+ * using the Tipsify algorithm (Sander, Nehab & Barczak, 2007).
+ */
+void optimizeVertexCache(std::vector<uint32_t>& faces, size_t vertexCount);
+
+/**
+ * @brief Renumbers vertices in the order the triangle list first uses them, so vertex fetches walk
+ * the vertex buffer roughly sequentially. Vertices that no triangle uses are dropped.
+ */
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces);
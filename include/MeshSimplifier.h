@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Mesh3D.h"
+
+/**
+ * @brief Simplifies a triangle list with quadric error metric edge collapses (Garland & Heckbert,
+ * 1997). Each collapse merges a vertex into one of its neighbors, so the result indexes the same
+ * vertex list as the input, and needs no new vertices. Vertices on mesh boundaries and on
+ * attribute seams (where several vertices share a position but differ in normal or texture
+ * coordinate) never move, so silhouettes and texture mapping are preserved.
+ *
+ * @param targetTriangleCount stop once the mesh has at most this many triangles. The result may
+ * have more, if no further collapse is possible without moving a locked vertex or folding a triangle over.
+ * @return the simplified triangle list, and an estimate of the largest distance, in the mesh's
+ * local space, between the simplified surface and the input surface.
+ */
+MeshLod simplifyMesh(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces,
+	size_t targetTriangleCount);
@@ -0,0 +1,43 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+
+// Defined in Mesh3D.h, which includes this header.
+struct Vertex3D;
+
+// The most triangles in one meshlet.
+const size_t MESHLET_MAX_TRIANGLES = 128;
+
+/**
+ * @brief A small, spatially coherent cluster of a mesh's triangles, with the bounds needed to
+ * cull it on its own: a bounding sphere for frustum culling, and a cone bounding its triangles'
+ * normals for backface culling.
+ */
+struct Meshlet {
+	// The meshlet's triangles are the indices [firstIndex, firstIndex + indexCount) of the mesh's faces.
+	uint32_t firstIndex;
+	uint32_t indexCount;
+
+	glm::vec3 center;
+	float radius;
+
+	// The average normal of the meshlet's triangles, and the sine of the largest angle between it
+	// and any of their normals. A cutoff of 1 means the normals are too spread out to ever cull.
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+/**
+ * @brief Partitions a mesh's triangles into meshlets of at most MESHLET_MAX_TRIANGLES each, by
+ * growing each meshlet outward across neighboring triangles from a seed triangle. Reorders the
+ * faces so that each meshlet is a contiguous range, keeping the existing order within a meshlet.
+ */
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces);
+
+/**
+ * @brief Whether every triangle of a meshlet faces away from a camera at the given position. All
+ * arguments must be in the same space.
+ */
+bool meshletBackfacing(const glm::vec3& center, float radius, const glm::vec3& coneAxis, float coneCutoff,
+	const glm::vec3& cameraPosition);
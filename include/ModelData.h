@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <string>
+#include <vector>
+#include "Mesh3D.h"
+
+/**
+ * @brief A texture used by an imported mesh: the texture's name as written in the model's material
+ * (usually a path relative to the model file), and the sampler2D uniform it binds to.
+ */
+struct TextureRef {
+	std::string samplerName;
+	std::string name;
+	// The index in ModelData::embeddedTextures of the texture, if it is stored inside the model file
+	// rather than next to it; otherwise -1.
+	int32_t embeddedTexture = -1;
+};
+
+/**
+ * @brief A texture stored inside a model file, as in GLB and some FBX files.
+ */
+struct EmbeddedTexture {
+	// "*" followed by the texture's index in the model: "*0", "*1", .... Materials that name an
+	// embedded texture by its original file name are resolved to its index on import.
+	std::string name;
+	// The size of the texture in pixels if `data` holds raw RGBA pixels, or 0x0 if `data` holds a
+	// compressed image file (PNG, JPEG, ...) as it was stored in the model.
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<unsigned char> data;
+};
+
+/**
+ * @brief The processed, CPU-side geometry of one imported mesh, ready to be uploaded to the GPU.
+ */
+struct MeshData {
+	// The name of the mesh in the source model, or of the node its merged meshes came from.
+	std::string name;
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> faces;
+	std::vector<TextureRef> textures;
+	// The vertex format to store the mesh in on the GPU, chosen at import.
+	VertexFormat format = VertexFormat::Float32;
+	// Simplified versions of the mesh over the same vertices, from finest to coarsest.
+	std::vector<MeshLod> lods;
+	// The full mesh's faces partitioned into clusters, which are contiguous ranges of faces.
+	std::vector<Meshlet> meshlets;
+};
+
+/**
+ * @brief One node of an imported model's hierarchy.
+ */
+struct NodeData {
+	std::string name;
+	glm::mat4 baseTransform;
+	// Indices into ModelData::meshes of the meshes drawn by this node.
+	std::vector<uint32_t> meshes;
+	std::vector<NodeData> children;
+};
+
+/**
+ * @brief Everything needed to build an Object3D from an imported model without touching Assimp.
+ */
+struct ModelData {
+	std::vector<MeshData> meshes;
+	std::vector<EmbeddedTexture> embeddedTextures;
+	NodeData root;
+};
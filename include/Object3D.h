@@ -2,15 +2,42 @@
 #include <memory>
 #include "ShaderProgram.h"
 #include "Mesh3D.h"
+#include "InstanceBatch.h"
+#include "IndirectRenderer.h"
+
+/**
+ * @brief The state shared by every object during one traversal of a hierarchy for rendering.
+ */
+struct RenderPass {
+	// The program's "normalMatrix" and "modelViewProjection" uniforms.
+	UniformHandle normalMatrixUniform;
+	UniformHandle modelViewProjectionUniform;
+	// The camera's projection * view matrix.
+	glm::mat4 viewProjection;
+	// The view to choose levels of detail and cull for, or null to always render the full meshes.
+	const RenderView* view;
+	// Collects the draws of meshes shared by several objects, which are drawn instanced once the
+	// traversal is done.
+	InstanceBatcher& instances;
+	// Where to queue every draw instead of drawing it, or null to draw directly.
+	IndirectRenderer* indirect;
+};
+
 class Object3D {
 private:
-	// The object's list of meshes and children.
-	std::vector<Mesh3D> m_meshes;
+	static uint64_t s_topologyVersion;
+
+	// The object's list of meshes and children. Meshes may be shared with other objects.
+	std::vector<std::shared_ptr<Mesh3D>> m_meshes;
 	std::vector<Object3D> m_children;
 
-	// The object's position, orientation, and scale in world space.
+	// The object's position, orientation, and scale in world space. The orientation is stored as a
+	// unit quaternion; m_orientation holds the same rotation as Euler angles, for the Euler API,
+	// and is recomputed from the quaternion only when asked for after setRotation.
 	glm::vec3 m_position;
-	glm::vec3 m_orientation;
+	glm::quat m_rotation;
+	mutable glm::vec3 m_orientation;
+	mutable bool m_orientationDirty;
 	glm::vec3 m_scale;
 	glm::vec3 m_center;
 
@@ -20,12 +47,32 @@ private:
 	// The object's base transformation matrix.
 	glm::mat4 m_baseTransform;
 
+	// The cached local->parent and local->world matrices, and the world matrix's normal matrix.
+	// The local matrix is rebuilt only when the object's position, orientation, scale, or center
+	// change; the world and normal matrices only when the local matrix or any ancestor's world
+	// matrix changes.
+	mutable glm::mat4 m_localMatrix;
+	mutable glm::mat4 m_worldMatrix;
+	mutable glm::mat3 m_normalMatrix;
+	mutable bool m_localDirty;
+	mutable bool m_worldDirty;
+
 	// Some objects from Assimp imports have a "name" field, useful for debugging.
 	std::string m_name;
 
-	// Recomputes the local->world transformation matrix.
+	// The "normalMatrix" and "modelViewProjection" uniforms, resolved against the program
+	// identified by m_uniformProgram.
+	mutable UniformHandle m_normalMatrixUniform;
+	mutable UniformHandle m_modelViewProjectionUniform;
+	mutable uint32_t m_uniformProgram;
+
+	// Recomputes the local->parent transformation matrix.
 	glm::mat4 buildModelMatrix() const;
 
+	// Renders the hierarchy, and then the instanced batches it collected.
+	void renderPass(ShaderProgram& shaderProgram, const glm::mat4& viewProjection, const RenderView* view,
+		IndirectRenderer* indirect) const;
+
 
 public:
 	// No default constructor; you must have a mesh to initialize an object.
@@ -33,14 +80,57 @@ public:
 
 	Object3D(std::vector<Mesh3D>&& meshes);
 	Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform);
+	/**
+	 * @brief Constructs an object that draws meshes which other objects may draw too. Meshes drawn
+	 * by more than one object are batched into instanced draws.
+	 */
+	Object3D(std::vector<std::shared_ptr<Mesh3D>>&& meshes, const glm::mat4& baseTransform);
 
 	// Simple accessors.
 	const glm::vec3& getPosition() const;
+	/**
+	 * @brief The object's orientation as Euler angles in radians: a rotation about Z, then X, then
+	 * Y, applied in that order from the outside in, i.e. Rz * Rx * Ry.
+	 */
 	const glm::vec3& getOrientation() const;
+	/**
+	 * @brief The object's orientation as a unit quaternion, e.g. for interpolating with slerp.
+	 */
+	const glm::quat& getRotation() const;
 	const glm::vec3& getScale() const;
 	const glm::vec3& getCenter() const;
 	const std::string& getName() const;
 	const glm::vec4& getMaterial() const;
+	const std::vector<std::shared_ptr<Mesh3D>>& getMeshes() const;
+	/**
+	 * @brief The object's local->parent transformation matrix.
+	 */
+	const glm::mat4& getLocalMatrix() const;
+
+	/**
+	 * @brief A number that changes whenever an object gains a child, or hierarchyChanged() is
+	 * called. Structures that point into object hierarchies, like a RenderList, are valid as long
+	 * as it stays the same. Must only be used on the GL thread.
+	 */
+	static uint64_t topologyVersion();
+
+	/**
+	 * @brief Changes the topology version. Whoever owns a list of root objects must call this
+	 * whenever it adds, removes, or moves any of them. Must only be called on the GL thread, like
+	 * every other edit of a hierarchy that is being rendered.
+	 */
+	static void hierarchyChanged();
+
+	/**
+	 * @brief The rotation of Euler angles, as in setOrientation.
+	 */
+	static glm::quat eulerRotation(const glm::vec3& orientation);
+
+	/**
+	 * @brief The matrix that transforms normals for a model matrix: the inverse transpose of its
+	 * upper 3x3.
+	 */
+	static glm::mat3 normalMatrix(const glm::mat4& model);
 
 	// Child management.
 	size_t numberOfChildren() const;
@@ -51,6 +141,7 @@ public:
 	// Simple mutators.
 	void setPosition(const glm::vec3& position);
 	void setOrientation(const glm::vec3& orientation);
+	void setRotation(const glm::quat& rotation);
 	void setScale(const glm::vec3& scale);
 	void setCenter(const glm::vec3& center);
 	void setName(const std::string& name);
@@ -58,11 +149,33 @@ public:
 
 	// Transformations.
 	void move(const glm::vec3& offset);
+	/**
+	 * @brief Adds to the object's Euler angles. Kept for compatibility: each call converts the
+	 * orientation to Euler angles and back.
+	 */
 	void rotate(const glm::vec3& rotation);
+	/**
+	 * @brief Turns the object by a rotation in its local space, i.e. after its current orientation.
+	 */
+	void rotate(const glm::quat& rotation);
 	void grow(const glm::vec3& growth);
 	void addChild(Object3D&& child);
 
 	// Rendering.
-	void render(ShaderProgram& shaderProgram) const;
-	void renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	/**
+	 * @brief Renders the full meshes of the object, as seen through the camera's projection * view
+	 * matrix.
+	 */
+	void render(ShaderProgram& shaderProgram, const glm::mat4& viewProjection) const;
+	/**
+	 * @brief Renders the object, choosing each mesh's level of detail for the given view.
+	 */
+	void render(ShaderProgram& shaderProgram, const RenderView& view) const;
+	/**
+	 * @brief Queues the draws of the object's meshes that may be visible in the view, choosing each
+	 * one's level of detail. The draws are issued by the IndirectRenderer's next flush.
+	 */
+	void render(ShaderProgram& shaderProgram, const RenderView& view, IndirectRenderer& indirect) const;
+	void renderRecursive(ShaderProgram& shaderProgram, const RenderPass& pass,
+		const glm::mat4& parentMatrix, bool parentChanged) const;
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BoundingBox.h"
+
+/**
+ * @brief A coarse copy of a mesh's triangles, kept on the CPU so the mesh can be rasterized into
+ * an OcclusionBuffer.
+ */
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+/**
+ * @brief An occluder mesh, placed in the world by a model matrix.
+ */
+struct OccluderDraw {
+	std::shared_ptr<const OccluderMesh> mesh;
+	glm::mat4 model;
+};
+
+/**
+ * @brief A low-resolution depth buffer on the CPU. A few large occluder meshes are rasterized into
+ * it each frame, and then objects are tested against it: an object whose screen-space bounding
+ * rectangle is behind the occluders at every pixel is hidden, and need not be drawn.
+ *
+ * Rasterizing can run on the buffer's own worker thread while the caller does other work; every
+ * query waits for it to finish. Depths are window-space, 0 at the near plane and 1 at the far.
+ */
+class OcclusionBuffer {
+	size_t m_width;
+	size_t m_height;
+	std::vector<float> m_depth;
+	glm::mat4 m_viewProjection;
+
+	// The rasterization waiting for, or running on, the worker thread.
+	std::thread m_worker;
+	mutable std::mutex m_mutex;
+	mutable std::condition_variable m_changed;
+	bool m_pending;
+	bool m_stopping;
+	glm::mat4 m_pendingViewProjection;
+	std::vector<OccluderDraw> m_pendingOccluders;
+
+	void work();
+	// rasterize, without waiting for the worker thread; the worker calls it while still pending.
+	void rasterizeNow(const glm::mat4& viewProjection, const std::vector<OccluderDraw>& occluders);
+	void rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+public:
+	/**
+	 * @param width the buffer's width in pixels, rounded up to a multiple of 4.
+	 */
+	OcclusionBuffer(size_t width, size_t height);
+	~OcclusionBuffer();
+	OcclusionBuffer(const OcclusionBuffer&) = delete;
+	OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+
+	/**
+	 * @brief Clears the buffer and rasterizes the occluders into it, as seen through the given
+	 * view-projection matrix, once any rasterization on the worker thread has finished.
+	 */
+	void rasterize(const glm::mat4& viewProjection, const std::vector<OccluderDraw>& occluders);
+
+	/**
+	 * @brief Starts rasterize on the worker thread, once any rasterization already in progress
+	 * has finished.
+	 */
+	void rasterizeAsync(const glm::mat4& viewProjection, std::vector<OccluderDraw>&& occluders);
+
+	/**
+	 * @brief Waits for the worker thread's rasterization, if any, to finish.
+	 */
+	void wait() const;
+
+	/**
+	 * @brief Whether any part of a world-space box may be in front of the occluders. Boxes that
+	 * cross the near plane or lie outside the buffer are always visible.
+	 */
+	bool boxVisible(const BoundingBox& box) const;
+
+	size_t width() const;
+	size_t height() const;
+	/**
+	 * @brief The depth at a pixel; (0, 0) is the lower-left corner.
+	 */
+	float depth(size_t x, size_t y) const;
+
+	/**
+	 * @brief Writes the buffer to a grayscale PNG for debugging: nearer is brighter, and pixels
+	 * that no occluder covers are black.
+	 */
+	void saveDebugImage(const std::filesystem::path& path) const;
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Object3D.h"
+#include "OcclusionBuffer.h"
+#include "RenderQueue.h"
+
+/**
+ * @brief A scene's Object3D hierarchies flattened into contiguous arrays, one entry per node in
+ * level order (roots, then their children, then theirs, ...), and one entry per mesh draw. Each
+ * frame, world transforms are updated level by level with a SIMD kernel, and the draws are
+ * issued in one linear pass over the draw list. Each node is bounded by a box around its whole
+ * subtree, so subtrees outside the view frustum, or hidden behind an OcclusionBuffer's occluders,
+ * are skipped with a single test. The draws that are issued one by one are sorted by state and
+ * depth first.
+ *
+ * The arrays point at the scene's objects and meshes, so they are recompiled whenever
+ * Object3D::topologyVersion() changes; between recompilations only the transforms are updated.
+ * Which meshes are batched into instanced draws is fixed when they are imported, so it can't
+ * change between recompilations either.
+ */
+class RenderList {
+	// Per node.
+	std::vector<const Object3D*> m_nodes;
+	// The index of each node's parent, or -1 for a root.
+	std::vector<int32_t> m_parents;
+	std::vector<glm::mat4> m_localMatrices;
+	std::vector<glm::mat4> m_worldMatrices;
+	std::vector<glm::mat3> m_normalMatrices;
+	// Whether each node's world matrix changed in the last update.
+	std::vector<uint8_t> m_worldChanged;
+	// World-space boxes around each node's own meshes, and around those of its whole subtree.
+	std::vector<BoundingBox> m_ownBounds;
+	std::vector<BoundingBox> m_subtreeBounds;
+	// Whether each node's subtree may be visible, during a render.
+	mutable std::vector<uint8_t> m_nodeVisible;
+	// Whether each hidden node's subtree was hidden by occluders rather than outside the frustum.
+	mutable std::vector<uint8_t> m_nodeOccluded;
+	// Each node's meshes are the draws [m_firstDraw, m_firstDraw + m_drawCount).
+	std::vector<uint32_t> m_firstDraw;
+	std::vector<uint32_t> m_drawCount;
+	// The first node of each level, and one past the last node.
+	std::vector<size_t> m_levelStarts;
+
+	// Per draw.
+	std::vector<const Mesh3D*> m_meshes;
+	std::vector<uint32_t> m_drawNodes;
+	// An id for each draw's set of textures; draws with equal ids bind the same textures.
+	std::vector<uint32_t> m_textureSets;
+	// Whether each draw's mesh is drawn by other nodes too, and so should be batched into
+	// instanced draws.
+	std::vector<uint8_t> m_sharedMeshes;
+	// The draws whose meshes are occluders.
+	std::vector<uint32_t> m_occluderDraws;
+
+	// The draws issued one by one in a render, reused between frames.
+	mutable RenderQueue m_queue;
+
+	// The topology version the arrays were compiled at.
+	uint64_t m_topologyVersion;
+
+	// The "normalMatrix" and "modelViewProjection" uniforms, resolved against the program
+	// identified by m_uniformProgram.
+	mutable UniformHandle m_normalMatrixUniform;
+	mutable UniformHandle m_modelViewProjectionUniform;
+	mutable uint32_t m_uniformProgram;
+
+	void compile(const std::vector<Object3D>& roots);
+	void addNode(const Object3D& object, int32_t parent, std::vector<std::vector<uint32_t>>& textureSets);
+	void updateBounds();
+	void renderDraws(ShaderProgram& program, const RenderView& view, IndirectRenderer* indirect,
+		const OcclusionBuffer* occlusion) const;
+
+public:
+	RenderList();
+
+	/**
+	 * @brief Recompiles the list if the scene's topology has changed since the last update, and
+	 * then recomputes the world and normal matrices of the nodes whose transforms have changed,
+	 * and the bounds of the subtrees they are in.
+	 */
+	void update(const std::vector<Object3D>& roots);
+
+	size_t nodeCount() const;
+	size_t drawCount() const;
+	const glm::mat4& worldMatrix(size_t node) const;
+
+	/**
+	 * @brief The occluder meshes of the list's draws, placed by their world matrices as of the
+	 * last update, for rasterizing into an OcclusionBuffer.
+	 */
+	std::vector<OccluderDraw> occluders() const;
+
+	/**
+	 * @brief Renders every draw that may be visible in the view, as of the last update.
+	 * @param occlusion if given, subtrees it finds hidden are skipped as well. It must have been
+	 * rasterized from the same view.
+	 */
+	void render(ShaderProgram& program, const RenderView& view, const OcclusionBuffer* occlusion = nullptr) const;
+	/**
+	 * @brief Queues every draw that may be visible in the view, as of the last update. The draws
+	 * are issued by the IndirectRenderer's next flush.
+	 */
+	void render(ShaderProgram& program, const RenderView& view, IndirectRenderer& indirect,
+		const OcclusionBuffer* occlusion = nullptr) const;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Collects a frame's draws, each identified by a 64-bit sort key, and sorts them so that
+ * draws sharing expensive state are issued together. From the most significant bits down, a key
+ * holds the draw's pass, program, texture set, and vertex array, and then its depth: opaque draws
+ * sort front to back, so that nearer surfaces fill the depth buffer first and hide the rest
+ * earlier, and transparent ones back to front, so that they blend correctly.
+ *
+ * Ids wider than their field are truncated to it. That only makes some draws with different
+ * state sort as if they were the same; the order is still a valid one.
+ */
+class RenderQueue {
+public:
+	enum class Pass : uint8_t {
+		Opaque,
+		Transparent
+	};
+
+	// The width of each field of a key, from the most significant down.
+	static const uint32_t PASS_BITS = 2;
+	static const uint32_t PROGRAM_BITS = 8;
+	static const uint32_t TEXTURE_SET_BITS = 16;
+	static const uint32_t VERTEX_ARRAY_BITS = 14;
+	static const uint32_t DEPTH_BITS = 24;
+
+	/**
+	 * @brief Packs a draw's state into a sort key.
+	 * @param depth the draw's distance from the camera, in any non-negative unit.
+	 */
+	static uint64_t key(Pass pass, uint32_t program, uint32_t textureSet, uint32_t vertexArray, float depth);
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint32_t item;
+	};
+
+	std::vector<Entry> m_entries;
+	// Scratch space for the sort, reused between frames.
+	std::vector<Entry> m_sorted;
+	std::vector<uint32_t> m_items;
+
+public:
+	void clear();
+
+	/**
+	 * @brief Queues a draw, identified by whatever the caller needs to issue it later.
+	 */
+	void push(uint64_t key, uint32_t item);
+
+	/**
+	 * @brief Sorts the queued draws by key with a least-significant-digit radix sort, which keeps
+	 * draws with equal keys in the order they were pushed.
+	 */
+	void sort();
+
+	/**
+	 * @brief The queued draws' items, in the queue's current order.
+	 */
+	const std::vector<uint32_t>& items();
+
+	/**
+	 * @brief How many program, texture set, and vertex array changes issuing the draws in the
+	 * queue's current order would take, counting the first draw's binds.
+	 */
+	uint32_t stateChanges() const;
+
+	size_t size() const;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include "BoundingBox.h"
+
+/**
+ * @brief Counters of the work submitted while rendering a frame.
+ */
+struct RenderStats {
+	uint64_t trianglesSubmitted = 0;
+	uint32_t drawCalls = 0;
+	uint32_t meshletsTested = 0;
+	uint32_t meshletsCulled = 0;
+	// Scene nodes whose subtree bounds were tested against the frustum, and those found outside
+	// it, whose whole subtree was skipped.
+	uint32_t nodesTested = 0;
+	uint32_t nodesCulled = 0;
+	// The full-detail triangles of the meshes skipped by node and mesh frustum culling.
+	uint64_t trianglesCulled = 0;
+	// Scene nodes inside the frustum whose subtree was hidden behind the occluders, and the
+	// full-detail triangles of the meshes they skipped.
+	uint32_t nodesOccluded = 0;
+	uint64_t trianglesOccluded = 0;
+	// The program, texture set, and vertex array changes that the draws issued one by one would
+	// take in scene order, and those they took after sorting by state.
+	uint32_t stateChangesUnsorted = 0;
+	uint32_t stateChangesSorted = 0;
+};
+
+/**
+ * @brief The camera that a frame is rendered from, with what culling and level-of-detail
+ * selection need to know about it.
+ */
+struct RenderView {
+	glm::mat4 view;
+	glm::mat4 projection;
+	// projection * view.
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	// How many pixels tall an object of height 1 appears at a distance of 1 from the camera.
+	float pixelsPerUnit;
+	// The largest geometric error, in pixels, that a simplified level of detail may show on screen.
+	float lodErrorPixels;
+	// The left, right, bottom, top, near, and far planes of the view frustum in world space, as
+	// (normal, distance) with normals pointing inward.
+	glm::vec4 frustumPlanes[6];
+	// Whether meshlets that face entirely away from the camera may be skipped. Only correct if
+	// back faces are never visible, i.e. every mesh is closed or GL_CULL_FACE is enabled.
+	bool cullBackfaces;
+
+	// What rendering with this view has submitted; reset it at the start of each frame.
+	mutable RenderStats stats;
+
+	/**
+	 * @param viewportHeight the height of the viewport, in pixels.
+	 */
+	RenderView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition,
+		float viewportHeight, float lodErrorPixels = 1.0f);
+
+	/**
+	 * @brief Whether any part of a world-space sphere may be inside the view frustum.
+	 */
+	bool sphereVisible(const glm::vec3& center, float radius) const;
+	/**
+	 * @brief Whether any part of a world-space box may be inside the view frustum.
+	 */
+	bool boxVisible(const BoundingBox& box) const;
+};
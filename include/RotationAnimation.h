@@ -7,23 +7,29 @@
 class RotationAnimation : public Animation {
 private:
 	/**
-	 * @brief How much to increment the orientation by each second.
+	 * @brief The axis to turn the object about, in its local space, and how many radians to turn
+	 * it by each second.
 	 */
-	glm::vec3 m_perSecond;
+	glm::vec3 m_axis;
+	float m_radiansPerSecond;
 
 	/**
 	 * @brief Advance the animation by the given time interval.
 	 */
 	void applyAnimation(float dt) override {
-		object().rotate(m_perSecond * dt);
+		object().rotate(glm::angleAxis(m_radiansPerSecond * dt, m_axis));
 	}
 
 public:
 	/**
 	 * @brief Constructs a animation of a constant rotation by the given total rotation
-	 * angle, linearly interpolated across the given duration.
+	 * angle, linearly interpolated across the given duration. The angles are taken as a rotation
+	 * vector: the object turns about its local axis along totalRotation, by its length. For a
+	 * rotation about a single axis, that is the same as adding to that Euler angle.
 	 */
 	RotationAnimation(Object3D& object, float duration, const glm::vec3& totalRotation) :
-		Animation(object, duration), m_perSecond(totalRotation / duration) {}
+		Animation(object, duration),
+		m_axis(glm::length(totalRotation) > 0 ? glm::normalize(totalRotation) : glm::vec3(0, 1, 0)),
+		m_radiansPerSecond(glm::length(totalRotation) / duration) {}
 };
 
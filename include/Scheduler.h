@@ -0,0 +1,94 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A thread-safe queue of suspended coroutines, waiting to be resumed by whichever thread
+ * drains the queue.
+ */
+class CoroutineQueue {
+	std::deque<std::coroutine_handle<>> m_pending;
+	std::mutex m_mutex;
+	std::condition_variable m_available;
+	bool m_closed;
+
+public:
+	CoroutineQueue();
+
+	void post(std::coroutine_handle<> coroutine);
+
+	/**
+	 * @brief Resumes every coroutine that is queued right now, without waiting for more.
+	 */
+	void runPending();
+
+	/**
+	 * @brief Waits for a coroutine to be queued and resumes it.
+	 * @return false, without resuming anything, once the queue has been closed.
+	 */
+	bool runNext();
+
+	/**
+	 * @brief Wakes every thread waiting in runNext, and makes them return false.
+	 */
+	void close();
+};
+
+/**
+ * @brief A fixed pool of background threads, one per core, that resume coroutines posted to it.
+ */
+class WorkerPool {
+	CoroutineQueue m_queue;
+	std::vector<std::thread> m_threads;
+
+	WorkerPool();
+
+public:
+	~WorkerPool();
+
+	static WorkerPool& instance();
+
+	CoroutineQueue& queue() { return m_queue; }
+};
+
+/**
+ * @brief The coroutines waiting to run on the thread that owns the GL context. The render loop
+ * must call runPending() on it once per frame.
+ */
+CoroutineQueue& glThreadQueue();
+
+/**
+ * @brief Whether the calling thread is the GL thread: the program's main thread, which creates the
+ * GL context and drains glThreadQueue().
+ */
+bool onGLThread();
+
+/**
+ * @brief Awaiting a ResumeOn suspends the coroutine and resumes it from the given queue.
+ */
+struct ResumeOn {
+	CoroutineQueue& queue;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> coroutine) { queue.post(coroutine); }
+	void await_resume() const noexcept {}
+};
+
+/**
+ * @brief co_await resumeOnWorker() continues the coroutine on a background thread.
+ */
+inline ResumeOn resumeOnWorker() {
+	return ResumeOn{ WorkerPool::instance().queue() };
+}
+
+/**
+ * @brief co_await resumeOnGLThread() continues the coroutine on the GL thread, the next time the
+ * render loop drains glThreadQueue().
+ */
+inline ResumeOn resumeOnGLThread() {
+	return ResumeOn{ glThreadQueue() };
+}
@@ -1,8 +1,28 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <string>
+#include <unordered_map>
+
+/**
+ * @brief The location of a uniform in a linked ShaderProgram. Resolve it once with
+ * ShaderProgram::getUniform, then reuse it to set the uniform without any name lookup.
+ */
+struct UniformHandle {
+	// -1 if the uniform is not an active uniform of the program; setting it is then a no-op.
+	int32_t location = -1;
+
+	bool isValid() const { return location >= 0; }
+};
+
 class ShaderProgram {
 	uint32_t m_programId;
+	// The locations of the program's active uniforms, introspected once when the program is linked.
+	std::unordered_map<std::string, int32_t> m_uniformLocations;
+	// How many uniforms have been looked up by name since the last resetLookupCount().
+	mutable uint32_t m_lookupCount;
+
+	// Queries GL_ACTIVE_UNIFORMS and fills the uniform location table.
+	void introspectUniforms();
 
 public:
 	ShaderProgram();
@@ -10,6 +30,21 @@ public:
 
 	void activate();
 
+	uint32_t getId() const;
+
+	/**
+	 * @brief Resolves a uniform name to a handle that can be reused for every subsequent
+	 * setUniform call. Does not call into the driver.
+	 */
+	UniformHandle getUniform(const std::string& uniformName) const;
+
+	/**
+	 * @brief The number of by-name uniform lookups (getUniform, or setUniform with a name)
+	 * since the last reset. Call resetLookupCount() once per frame to get a per-frame count.
+	 */
+	uint32_t lookupCount() const;
+	void resetLookupCount();
+
 	void setUniform(const std::string& uniformName, bool value);
 	void setUniform(const std::string& uniformName, int32_t value);
 	void setUniform(const std::string& uniformName, float value);
@@ -19,4 +54,14 @@ public:
 	void setUniform(const std::string& uniformName, const glm::mat2& value);
 	void setUniform(const std::string& uniformName, const glm::mat3& value);
 	void setUniform(const std::string& uniformName, const glm::mat4& value);
-};
\ No newline at end of file
+
+	void setUniform(UniformHandle uniform, bool value);
+	void setUniform(UniformHandle uniform, int32_t value);
+	void setUniform(UniformHandle uniform, float value);
+	void setUniform(UniformHandle uniform, const glm::vec2& value);
+	void setUniform(UniformHandle uniform, const glm::vec3& value);
+	void setUniform(UniformHandle uniform, const glm::vec4& value);
+	void setUniform(UniformHandle uniform, const glm::mat2& value);
+	void setUniform(UniformHandle uniform, const glm::mat3& value);
+	void setUniform(UniformHandle uniform, const glm::mat4& value);
+};
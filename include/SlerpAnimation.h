@@ -0,0 +1,43 @@
+#pragma once
+#include <algorithm>
+#include "Object3D.h"
+#include "Animation.h"
+/**
+ * @brief Turns an object from its orientation when the animation starts to a target orientation
+ * over an interval, along the shortest arc at a constant angular speed.
+ */
+class SlerpAnimation : public Animation {
+private:
+	/**
+	 * @brief The orientation to interpolate from, captured when the animation starts.
+	 */
+	glm::quat m_from;
+	glm::quat m_to;
+
+	void startAnimation() override {
+		m_from = object().getRotation();
+	}
+
+	/**
+	 * @brief Advance the animation by the given time interval.
+	 */
+	void applyAnimation(float) override {
+		float t = std::clamp(currentTime() / duration(), 0.0f, 1.0f);
+		object().setRotation(glm::slerp(m_from, m_to, t));
+	}
+
+public:
+	/**
+	 * @brief Constructs an animation that turns the object to the given orientation across the
+	 * given duration.
+	 */
+	SlerpAnimation(Object3D& object, float duration, const glm::quat& targetRotation) :
+		Animation(object, duration), m_from(targetRotation), m_to(targetRotation) {}
+
+	/**
+	 * @brief Constructs an animation that turns the object to the orientation of the given Euler
+	 * angles, as in Object3D::setOrientation, across the given duration.
+	 */
+	SlerpAnimation(Object3D& object, float duration, const glm::vec3& targetOrientation) :
+		SlerpAnimation(object, duration, Object3D::eulerRotation(targetOrientation)) {}
+};
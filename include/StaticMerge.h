@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include <unordered_set>
+#include "ModelData.h"
+
+/**
+ * @brief Merges the meshes of every static subtree of a model into as few meshes as possible.
+ * A subtree is static if no animation targets any of its nodes. Each static subtree's meshes are
+ * transformed into the space of the subtree's root, concatenated with the other meshes that use
+ * the same textures, and drawn by the root; the subtree's descendants are removed. Meshes that
+ * aren't merged are kept, and model.meshes is rebuilt to hold only the meshes that are still used.
+ *
+ * Must run before meshes are optimized and simplified, since the merged meshes are new.
+ * @param animatedNodes the names of the nodes that animations target.
+ */
+void mergeStaticMeshes(ModelData& model, const std::unordered_set<std::string>& animatedNodes);
+
+/**
+ * @brief The number of meshes drawn by a node and its descendants, i.e., the number of draw calls
+ * needed to render it.
+ */
+size_t countDrawCalls(const NodeData& node);
@@ -13,6 +13,10 @@ public:
     StbImage();
 
     void loadFromFile(const std::string& filepath);
+    // Decodes an image file (PNG, JPEG, ...) that is already in memory. `name` is only used in errors.
+    void loadFromMemory(const unsigned char* data, size_t size, const std::string& name);
+    // Copies already-decoded 8-bit RGBA pixels.
+    void loadFromPixels(const unsigned char* rgba, int width, int height);
 
     int getWidth() const;
     int getHeight() const;
@@ -0,0 +1,147 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief The state shared by every Task's promise: the awaiting coroutine to resume when the task
+ * finishes, and any exception the task ended with.
+ */
+struct TaskPromiseBase {
+	std::coroutine_handle<> continuation;
+	std::exception_ptr error;
+	std::atomic<bool> finished{ false };
+	// The task may finish on one thread while another thread is suspending to await it. Whichever
+	// of the two gets here second is responsible for resuming the awaiting coroutine.
+	std::atomic<bool> rendezvous{ false };
+
+	// Tasks start running as soon as they are called.
+	std::suspend_never initial_suspend() noexcept { return {}; }
+
+	struct FinalAwaiter {
+		bool await_ready() noexcept { return false; }
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			auto& promise = handle.promise();
+			promise.finished = true;
+			if (promise.rendezvous.exchange(true)) {
+				return promise.continuation;
+			}
+			return std::noop_coroutine();
+		}
+
+		void await_resume() noexcept {}
+	};
+
+	FinalAwaiter final_suspend() noexcept { return {}; }
+
+	void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+	std::optional<T> value;
+
+	void return_value(T result) { value.emplace(std::move(result)); }
+
+	T result() {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return std::move(*value);
+	}
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+	void return_void() {}
+
+	void result() {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+/**
+ * @brief A coroutine that nothing awaits. It starts running as soon as it is called, and its frame
+ * destroys itself when it finishes. An exception that escapes it terminates the program.
+ */
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/**
+ * @brief A coroutine that produces a T. The coroutine starts running as soon as it is called,
+ * and can be awaited with co_await from another coroutine, or polled with isReady().
+ *
+ * Each step of the coroutine runs on whichever thread resumed it, so it can hop between worker
+ * threads and the GL thread by awaiting resumeOnWorker() and resumeOnGLThread(). A Task must
+ * not be destroyed before its coroutine finishes.
+ */
+template <typename T>
+class Task {
+public:
+	struct promise_type : TaskPromise<T> {
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+	};
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+public:
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+	Task& operator=(Task&& other) noexcept {
+		if (this != &other) {
+			if (m_handle) {
+				m_handle.destroy();
+			}
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	~Task() {
+		if (m_handle) {
+			m_handle.destroy();
+		}
+	}
+
+	/**
+	 * @brief Whether the coroutine has finished, either with a result or an exception.
+	 */
+	bool isReady() const { return m_handle.promise().finished; }
+
+	/**
+	 * @brief The coroutine's result, or its exception rethrown. Only valid once isReady(), and
+	 * only once: the result is moved out.
+	 */
+	T get() { return m_handle.promise().result(); }
+
+	bool await_ready() const { return isReady(); }
+
+	bool await_suspend(std::coroutine_handle<> awaiting) {
+		m_handle.promise().continuation = awaiting;
+		// If the task finished in the meantime, don't suspend at all.
+		return !m_handle.promise().rendezvous.exchange(true);
+	}
+
+	T await_resume() { return get(); }
+};
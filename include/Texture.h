@@ -2,7 +2,25 @@
 #include <glad/glad.h>
 #include <string>
 #include <filesystem>
+#include <memory>
 #include "StbImage.h"
+#include "GLStateCache.h"
+
+/**
+ * @brief Owns a texture in VRAM, and deletes it when destroyed.
+ */
+struct TextureStorage {
+	uint32_t textureId;
+
+	explicit TextureStorage(uint32_t id) : textureId(id) {}
+	~TextureStorage() {
+		GLStateCache::instance().textureDeleted(textureId);
+		glDeleteTextures(1, &textureId);
+	}
+
+	TextureStorage(const TextureStorage&) = delete;
+	TextureStorage& operator=(const TextureStorage&) = delete;
+};
 
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
@@ -13,6 +31,9 @@ struct Texture {
 	uint32_t textureId;
 	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
 	std::string samplerName;
+	// Shared ownership of the texture's VRAM, for textures loaded through the TextureCache. The
+	// texture is deleted when the last Texture that refers to it is destroyed.
+	std::shared_ptr<const TextureStorage> storage;
 
 	/**
 	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
@@ -20,7 +41,8 @@ struct Texture {
 	static Texture loadImage(const StbImage& texture, const std::string& samplerName) {
 		uint32_t texId;
 		glGenTextures(1, &texId);
-		glBindTexture(GL_TEXTURE_2D, texId);
+		// The new texture stays bound to unit 0, where the cache knows to replace it when drawing.
+		GLStateCache::instance().bindTexture(0, texId);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -28,7 +50,6 @@ struct Texture {
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.getWidth(), texture.getHeight(), 0, GL_RGBA,
 			GL_UNSIGNED_BYTE, texture.getData());
 		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
 
 		return Texture{ texId, samplerName };
 	}
@@ -0,0 +1,65 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "Texture.h"
+
+/**
+ * @brief A process-wide cache of textures in VRAM, keyed by the canonical path of the image they
+ * were loaded from, so that every model (and every manually-loaded texture) referring to the same
+ * file shares one copy. Entries are reference counted through Texture::storage: the cache only
+ * holds weak references, and a texture is deleted as soon as the last Mesh3D using it goes away.
+ *
+ * Optionally, textures can also be deduplicated by the hash of their decoded pixels, so that
+ * identical images stored at different paths share one copy as well.
+ *
+ * The cache is not thread-safe, and must only be used on the thread that owns the GL context.
+ */
+class TextureCache {
+	std::unordered_map<std::filesystem::path, std::weak_ptr<const TextureStorage>> m_byPath;
+	std::unordered_map<uint64_t, std::weak_ptr<const TextureStorage>> m_byContent;
+	bool m_dedupByContent;
+
+	TextureCache();
+
+	// Removes entries whose textures have been deleted.
+	void purge();
+
+public:
+	static TextureCache& instance();
+
+	/**
+	 * @brief The key a path is cached under: the path, made absolute, with symlinks and "." and ".."
+	 * components resolved.
+	 */
+	static std::filesystem::path canonicalKey(const std::filesystem::path& path);
+
+	/**
+	 * @brief Enables or disables deduplication by pixel content. Hashing costs a pass over every
+	 * decoded image, so it is off by default.
+	 */
+	void setContentDedup(bool enabled);
+
+	/**
+	 * @brief Returns the cached texture for a path, bound to the given sampler, if it is still alive.
+	 */
+	std::optional<Texture> find(const std::filesystem::path& path, const std::string& samplerName);
+
+	/**
+	 * @brief Returns the cached texture for a path, decoding and uploading it first if necessary.
+	 */
+	Texture load(const std::filesystem::path& path, const std::string& samplerName);
+
+	/**
+	 * @brief Caches an image that has already been decoded from the given path, uploading it unless
+	 * the path (or, with content dedup enabled, an identical image) is already cached.
+	 */
+	Texture insert(const std::filesystem::path& path, const StbImage& image, const std::string& samplerName);
+
+	/**
+	 * @brief The number of distinct textures currently alive in the cache.
+	 */
+	size_t size();
+};
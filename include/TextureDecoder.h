@@ -0,0 +1,43 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include "StbImage.h"
+
+/**
+ * @brief An image to decode: either a file on disk, or an image held in memory, such as a texture
+ * embedded in a model file.
+ */
+struct ImageSource {
+	// The image file; for an in-memory image, the name it is cached under.
+	std::filesystem::path path;
+	// The in-memory image, if any. It must outlive the decoding.
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	// Nonzero if `data` holds raw RGBA pixels rather than an image file.
+	int width = 0;
+	int height = 0;
+
+	ImageSource(std::filesystem::path path) : path(std::move(path)) {
+	}
+
+	bool operator==(const ImageSource& other) const { return path == other.path; }
+
+	/**
+	 * @brief Decodes the image, reading the file only if the image isn't in memory.
+	 */
+	void decode(StbImage& image) const;
+};
+
+/**
+ * @brief Decodes a list of images on the WorkerPool, with the calling thread decoding alongside
+ * it, so that decoding progresses even while every worker is busy. Each decoded image is handed to
+ * `consume` on the calling thread as soon as it is ready, in no particular order, so the caller
+ * can upload it to the GPU while the remaining images are still decoding. At most a few decoded
+ * images wait for the consumer at any time.
+ *
+ * If any image fails to decode, the remaining images are still consumed, and then the first
+ * error is rethrown.
+ */
+void decodeTextures(const std::vector<ImageSource>& sources,
+	const std::function<void(const std::filesystem::path&, StbImage&&)>& consume);
@@ -0,0 +1,17 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+
+/**
+ * @brief Computes world[i] = world[parents[i]] * local[i] for every i in [first, last), in order.
+ * Each parent must come before its children, either before first or earlier in the range. Uses
+ * SSE where the target has it, and glm otherwise.
+ */
+void propagateTransforms(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+	size_t first, size_t last);
+
+/**
+ * @brief The same as propagateTransforms, with glm's scalar matrix product.
+ */
+void propagateTransformsScalar(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+	size_t first, size_t last);
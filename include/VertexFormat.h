@@ -0,0 +1,73 @@
+#pragma once
+#include <glm/ext.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Vertex3D;
+
+/**
+ * @brief How a mesh's vertices are stored in its vertex buffer. Every format feeds the same
+ * vertex shader inputs: position at location 0, normal at 1, texture coordinate at 2.
+ */
+enum class VertexFormat : uint32_t {
+	// 32 bytes: float position, normal, and texture coordinate (Vertex3D).
+	Float32,
+	// 20 bytes: float position, 10_10_10_2 normal, half-float texture coordinate (PackedVertex3D).
+	PackedAttributes,
+	// 16 bytes: 16-bit normalized position, 10_10_10_2 normal, half-float texture coordinate
+	// (QuantizedVertex3D). Positions are dequantized by a per-mesh scale and offset.
+	Quantized,
+};
+
+struct PackedVertex3D {
+	float x;
+	float y;
+	float z;
+	uint32_t normal;
+	uint32_t texCoord;
+};
+
+struct QuantizedVertex3D {
+	// x, y, z, and one unused component to keep the normal 4-byte aligned.
+	int16_t position[4];
+	uint32_t normal;
+	uint32_t texCoord;
+};
+
+/**
+ * @brief Maps a mesh's bounding box onto the [-1, 1] range of 16-bit normalized positions.
+ * A stored position q is dequantized as q * scale + offset.
+ */
+struct PositionQuantization {
+	glm::vec3 scale;
+	glm::vec3 offset;
+};
+
+/**
+ * @brief The quantization that covers all the given vertices.
+ */
+PositionQuantization positionQuantization(const std::vector<Vertex3D>& vertices);
+
+/**
+ * @brief Picks the most compact vertex format whose quantization error is acceptable for the
+ * mesh: positions may move by at most 1% of the mesh's average edge length, and texture
+ * coordinates by at most 1/4096 (one texel of a 4K texture).
+ */
+VertexFormat chooseVertexFormat(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces);
+
+/**
+ * @brief The size of one vertex in the given format.
+ */
+size_t vertexStride(VertexFormat format);
+
+/**
+ * @brief Encodes vertices into the given format, as raw bytes ready for glBufferData.
+ */
+std::vector<unsigned char> encodeVertices(const std::vector<Vertex3D>& vertices, VertexFormat format,
+	const PositionQuantization& quantization);
+
+/**
+ * @brief Sets up vertex attributes 0-2 of the currently-bound vertex array to read the given
+ * format from the currently-bound GL_ARRAY_BUFFER.
+ */
+void setVertexAttributes(VertexFormat format);
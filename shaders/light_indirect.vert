@@ -0,0 +1,47 @@
+#version 430
+// A vertex shader for rendering meshes submitted by multi-draw-indirect with normal vectors and
+// texture coordinates, which creates outputs needed for a Phong reflection fragment shader. Each
+// draw's model matrix, material, and position dequantization come from the draws buffer.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+// The index of this draw's entry in the draws buffer.
+layout (location=8) in uint drawIndex;
+
+struct Draw {
+    mat4 model;
+    vec4 material;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+layout (std430, binding=0) readonly buffer Draws {
+    Draw draws[];
+};
+
+uniform mat4 viewProjection;
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragWorldPos;
+flat out vec4 Material;
+
+// The inverse transpose of m's upper 3x3.
+mat3 drawNormalMatrix(mat4 m) {
+    vec3 bc = cross(m[1].xyz, m[2].xyz);
+    return mat3(bc, cross(m[2].xyz, m[0].xyz), cross(m[0].xyz, m[1].xyz)) / dot(m[0].xyz, bc);
+}
+
+void main() {
+    Draw draw = draws[drawIndex];
+    // Transform the vertex position from local space to world space, and then to clip space.
+    vec3 position = vPosition * draw.positionScale.xyz + draw.positionOffset.xyz;
+    vec4 worldPosition = draw.model * vec4(position, 1.0);
+    gl_Position = viewProjection * worldPosition;
+    FragWorldPos = vec3(worldPosition);
+    // Pass along the vertex texture coordinate.
+    TexCoord = vTexCoord;
+    // Transform the vertex normal from local space to world space, using the Normal matrix.
+    Normal = drawNormalMatrix(draw.model) * vNormal;
+    Material = draw.material;
+}
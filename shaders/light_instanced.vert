@@ -0,0 +1,37 @@
+#version 330
+// A vertex shader for rendering instanced vertices with normal vectors and texture coordinates,
+// which creates outputs needed for a Phong reflection fragment shader. Every draw must be
+// instanced: each instance has its own model matrix and material.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in mat4 instanceModel;
+layout (location=7) in vec4 instanceMaterial;
+
+uniform mat4 viewProjection;
+// Dequantizes the mesh's stored positions: (1, 1, 1) and (0, 0, 0) unless it uses 16-bit positions.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragWorldPos;
+flat out vec4 Material;
+
+// The inverse transpose of m's upper 3x3.
+mat3 instanceNormalMatrix(mat4 m) {
+    vec3 bc = cross(m[1].xyz, m[2].xyz);
+    return mat3(bc, cross(m[2].xyz, m[0].xyz), cross(m[0].xyz, m[1].xyz)) / dot(m[0].xyz, bc);
+}
+
+void main() {
+    // Transform the vertex position from local space to world space, and then to clip space.
+    vec4 worldPosition = instanceModel * vec4(vPosition * positionScale + positionOffset, 1.0);
+    gl_Position = viewProjection * worldPosition;
+    FragWorldPos = vec3(worldPosition);
+    // Pass along the vertex texture coordinate.
+    TexCoord = vTexCoord;
+    // Transform the vertex normal from local space to world space, using the Normal matrix.
+    Normal = instanceNormalMatrix(instanceModel) * vNormal;
+    Material = instanceMaterial;
+}
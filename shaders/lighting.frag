@@ -13,8 +13,9 @@ in vec3 FragWorldPos;
 // The mesh's base (diffuse) texture.
 uniform sampler2D baseTexture;
 
-// Material parameters for the whole mesh: k_a, k_d, k_s, shininess.
-uniform vec4 material;
+// Material parameters: k_a, k_d, k_s, shininess. The vertex shader passes along the "material"
+// uniform, or the instance's own material when the mesh is drawn instanced.
+flat in vec4 Material;
 
 // Ambient light color.
 uniform vec3 ambientColor;
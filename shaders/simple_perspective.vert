@@ -1,11 +1,20 @@
 #version 330
 layout (location=0) in vec3 vPosition;
+// The model matrix of each instance, when the mesh is drawn instanced.
+layout (location=3) in mat4 instanceModel;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// The projection * view * model matrix of a draw that isn't instanced.
+uniform mat4 modelViewProjection;
+// The projection * view matrix, which places instances by their own model matrices.
+uniform mat4 viewProjection;
+// Dequantizes the mesh's stored positions: (1, 1, 1) and (0, 0, 0) unless it uses 16-bit positions.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+// Whether this draw is instanced, in which case instanceModel replaces the model matrix.
+uniform bool instanced;
 
 void main() {
+    vec4 position = vec4(vPosition * positionScale + positionOffset, 1.0);
     // Project the position to clip space.
-    gl_Position = projection * view * model * vec4(vPosition, 1.0);
+    gl_Position = instanced ? viewProjection * (instanceModel * position) : modelViewProjection * position;
 }
\ No newline at end of file
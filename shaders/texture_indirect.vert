@@ -0,0 +1,42 @@
+#version 430
+// A vertex shader for perspective viewing of meshes submitted by multi-draw-indirect. Each draw's
+// model matrix and position dequantization come from the draws buffer rather than uniforms.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+// The index of this draw's entry in the draws buffer: the command's base instance, plus the
+// instance number within the command.
+layout (location=8) in uint drawIndex;
+
+struct Draw {
+    mat4 model;
+    vec4 material;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+layout (std430, binding=0) readonly buffer Draws {
+    Draw draws[];
+};
+
+uniform mat4 viewProjection;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+// The inverse transpose of m's upper 3x3.
+mat3 drawNormalMatrix(mat4 m) {
+    vec3 bc = cross(m[1].xyz, m[2].xyz);
+    return mat3(bc, cross(m[2].xyz, m[0].xyz), cross(m[0].xyz, m[1].xyz)) / dot(m[0].xyz, bc);
+}
+
+void main() {
+    Draw draw = draws[drawIndex];
+    // Transform the position to clip space.
+    vec3 position = vPosition * draw.positionScale.xyz + draw.positionOffset.xyz;
+    gl_Position = viewProjection * (draw.model * vec4(position, 1.0));
+    // Pass along the vertex texture coordinate.
+    TexCoord = vTexCoord;
+    // Transform the vertex normal from local space to world space, using the Normal matrix.
+    Normal = drawNormalMatrix(draw.model) * vNormal;
+}
@@ -0,0 +1,30 @@
+#version 330
+// A vertex shader for perspective viewing of an instanced mesh with normal vectors and texture
+// coordinates. Every draw must be instanced: each instance is placed by its own model matrix.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in mat4 instanceModel;
+
+uniform mat4 viewProjection;
+// Dequantizes the mesh's stored positions: (1, 1, 1) and (0, 0, 0) unless it uses 16-bit positions.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+// The inverse transpose of m's upper 3x3.
+mat3 instanceNormalMatrix(mat4 m) {
+    vec3 bc = cross(m[1].xyz, m[2].xyz);
+    return mat3(bc, cross(m[2].xyz, m[0].xyz), cross(m[0].xyz, m[1].xyz)) / dot(m[0].xyz, bc);
+}
+
+void main() {
+    // Transform the position to clip space.
+    gl_Position = viewProjection * (instanceModel * vec4(vPosition * positionScale + positionOffset, 1.0));
+    // Pass along the vertex texture coordinate.
+    TexCoord = vTexCoord;
+    // Transform the vertex normal from local space to world space, using the Normal matrix.
+    Normal = instanceNormalMatrix(instanceModel) * vNormal;
+}
@@ -3,20 +3,38 @@
 layout (location=0) in vec3 vPosition;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec2 vTexCoord;
+// The model matrix of each instance, when the mesh is drawn instanced.
+layout (location=3) in mat4 instanceModel;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// The projection * view * model and normal matrices of a draw that isn't instanced, computed on
+// the CPU whenever the model matrix or the camera changes.
+uniform mat4 modelViewProjection;
+uniform mat3 normalMatrix;
+// The projection * view matrix, which places instances by their own model matrices.
+uniform mat4 viewProjection;
+// Dequantizes the mesh's stored positions: (1, 1, 1) and (0, 0, 0) unless it uses 16-bit positions.
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+// Whether this draw is instanced, in which case instanceModel replaces the model matrix.
+uniform bool instanced;
 
 out vec2 TexCoord;
 out vec3 Normal;
 
+// The normal matrix of an instance: the inverse transpose of its model matrix's upper 3x3, whose
+// columns are the cross products of the 3x3's columns over its determinant. Much cheaper than
+// inverse(), for instances whose normal matrix isn't computed on the CPU.
+mat3 instanceNormalMatrix(mat4 m) {
+    vec3 bc = cross(m[1].xyz, m[2].xyz);
+    return mat3(bc, cross(m[2].xyz, m[0].xyz), cross(m[0].xyz, m[1].xyz)) / dot(m[0].xyz, bc);
+}
+
 void main() {
+    vec4 position = vec4(vPosition * positionScale + positionOffset, 1.0);
     // Transform the position to clip space.
-    gl_Position = projection * view * model * vec4(vPosition, 1.0);
+    gl_Position = instanced ? viewProjection * (instanceModel * position) : modelViewProjection * position;
     // Pass along the vertex texture coordinate.
     TexCoord = vTexCoord;
     // Transform the vertex normal from local space to world space, using the Normal matrix.
-    mat4 normalMatrix = transpose(inverse(model));
-    Normal = mat3(normalMatrix) * vNormal;
+    Normal = (instanced ? instanceNormalMatrix(instanceModel) : normalMatrix) * vNormal;
 }
\ No newline at end of file
@@ -1,107 +1,246 @@
 #include "AssimpImport.h"
+#include "CookedModel.h"
+#include "Hash.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "Scheduler.h"
+#include "StaticMerge.h"
+#include "TextureCache.h"
+#include "TextureDecoder.h"
 #include <iostream>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <algorithm>
+#include <exception>
 #include <filesystem>
 #include <unordered_map>
+#include <unordered_set>
 
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
 
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-	std::vector<Texture> textures;
+std::vector<TextureRef> materialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
+	const aiScene* scene) {
+	std::vector<TextureRef> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString name;
 		mat->GetTexture(type, i, &name);
-		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
+		TextureRef ref{ typeName, name.C_Str() };
+		// Embedded textures are named "*<index>", or (in FBX) by the file they were embedded from.
+		if (auto* embedded = scene->GetEmbeddedTexture(name.C_Str())) {
+			auto found = std::find(scene->mTextures, scene->mTextures + scene->mNumTextures, embedded);
+			ref.embeddedTexture = static_cast<int32_t>(found - scene->mTextures);
+		}
+		textures.push_back(ref);
+	}
+	return textures;
+}
 
-		auto existing = loadedTextures.find(texPath);
-		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
+/**
+ * @brief Copies a texture out of Assimp's scene. Compressed textures are kept as the image file
+ * they were embedded as, to be decoded later like any other; raw ones are converted to RGBA.
+ */
+EmbeddedTexture fromAssimpTexture(const aiTexture* texture, size_t index) {
+	EmbeddedTexture data;
+	data.name = "*" + std::to_string(index);
+	auto texels = reinterpret_cast<const unsigned char*>(texture->pcData);
+	if (texture->mHeight == 0) {
+		// mWidth is the size of the compressed file in bytes.
+		data.data.assign(texels, texels + texture->mWidth);
+	}
+	else {
+		data.width = texture->mWidth;
+		data.height = texture->mHeight;
+		data.data.reserve(size_t(data.width) * data.height * 4);
+		for (size_t i = 0; i < size_t(data.width) * data.height; i++) {
+			const aiTexel& texel = texture->pcData[i];
+			data.data.insert(data.data.end(), { texel.r, texel.g, texel.b, texel.a });
 		}
-		else {
-			StbImage image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
-			textures.push_back(tex);
-			loadedTextures.insert(std::make_pair(texPath, tex));
+	}
+	return data;
+}
+
+/**
+ * @brief Where to decode a texture referenced by a model from. Embedded textures are decoded from
+ * the model's copy of them, and cached under the name "<model path>#*<index>".
+ */
+ImageSource textureSource(const TextureRef& ref, const ModelData& model, const std::filesystem::path& modelPath) {
+	if (ref.embeddedTexture < 0) {
+		return ImageSource(modelPath.parent_path() / ref.name);
+	}
+	const EmbeddedTexture& embedded = model.embeddedTextures[ref.embeddedTexture];
+	ImageSource source(modelPath.string() + "#" + embedded.name);
+	source.data = embedded.data.data();
+	source.size = embedded.data.size();
+	source.width = embedded.width;
+	source.height = embedded.height;
+	return source;
+}
+
+std::vector<Texture> loadMaterialTextures(const std::vector<TextureRef>& textureRefs, const ModelData& model,
+	const std::filesystem::path& modelPath) {
+	auto& cache = TextureCache::instance();
+	std::vector<Texture> textures;
+	for (auto& ref : textureRefs)
+	{
+		ImageSource source = textureSource(ref, model, modelPath);
+		if (auto cached = cache.find(source.path, ref.samplerName)) {
+			textures.push_back(*cached);
+			continue;
 		}
+		StbImage image;
+		source.decode(image);
+		textures.push_back(cache.insert(source.path, image, ref.samplerName));
 	}
 	return textures;
 }
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-	std::vector<Vertex3D> vertices;
+MeshData fromAssimpMesh(const aiMesh* mesh, const aiScene* scene) {
+	MeshData data;
+	data.name = mesh->mName.C_Str();
 
-	// TODO: fill in this vertices list, by iterating over each element of 
-	// the mVertices field of the aiMesh pointer. Each element of mVertices
-	// has x, y, and z values that you can use to construct a Vertex3D object.
-	// To find the u and v texture coordinates of a vertex, access the 
-	// x and y fields of each element of mTextureCoords.
-	// To find the normal vector of a vertex, access the x, y, and z fields
-	// of each eleemnt of mNormals.
+	std::vector<Vertex3D>& vertices = data.vertices;
+	vertices.reserve(mesh->mNumVertices);
 	for (size_t i = 0; i < mesh->mNumVertices; i++) {
 		auto& meshVertex = mesh->mVertices[i];
-		auto& texCoord = mesh->mTextureCoords[0][i];
-		auto& normal = mesh->mNormals[i];
-
-		// See above.
-
-
-
+		// Not every mesh has texture coordinates; those that don't are drawn with (0, 0).
+		aiVector3D texCoord = mesh->HasTextureCoords(0) ? mesh->mTextureCoords[0][i] : aiVector3D();
+		aiVector3D normal = mesh->HasNormals() ? mesh->mNormals[i] : aiVector3D();
 
+		vertices.emplace_back(meshVertex.x, meshVertex.y, meshVertex.z,
+			normal.x, normal.y, normal.z,
+			texCoord.x, texCoord.y);
 	}
 
-	std::vector<uint32_t> faces;
-	// TODO: fill in the faces list, by iterating over each element of
-	// the mFaces field of the aiMesh pointer. Each element of mFaces
-	// has an mIndices list, which will have three elements of its own at 
-	// [0], [1], and [2]. Each of those should be pushed individually onto 
-	// the faces list.
+	std::vector<uint32_t>& faces = data.faces;
+	faces.reserve(mesh->mNumFaces * VERTICES_PER_FACE);
 	for (size_t i = 0; i < mesh->mNumFaces; i++) {
 		auto& meshFace = mesh->mFaces[i];
-		// See above.
-
-
-
+		// Triangulation leaves point and line primitives alone; we only draw triangles.
+		if (meshFace.mNumIndices != VERTICES_PER_FACE) {
+			continue;
+		}
+		faces.push_back(meshFace.mIndices[0]);
+		faces.push_back(meshFace.mIndices[1]);
+		faces.push_back(meshFace.mIndices[2]);
 	}
 
-	// Load any base textures, specular maps, and normal maps associated with the mesh.
-	std::vector<Texture> textures = {};
+	// Find any base textures, specular maps, and normal maps associated with the mesh.
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
+		std::vector<TextureRef>& textures = data.textures;
+		std::vector<TextureRef> diffuseMaps = materialTextures(material,
+			aiTextureType_DIFFUSE, "baseTexture", scene);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures);
+		std::vector<TextureRef> specularMaps = materialTextures(material,
+			aiTextureType_SPECULAR, "specMap", scene);
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
+		std::vector<TextureRef> normalMaps = materialTextures(material,
+			aiTextureType_HEIGHT, "normalMap", scene);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		normalMaps = loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
+		normalMaps = materialTextures(material,
+			aiTextureType_NORMALS, "normalMap", scene);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	}
 
-	return Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
+	return data;
 }
 
+/**
+ * @brief Reorders a mesh's triangles for the post-transform vertex cache, groups them into
+ * meshlets, and reorders its vertices for fetch locality. Reports how much the vertex cache
+ * behavior improved.
+ */
+void optimizeMesh(MeshData& mesh, const std::string& name) {
+	auto before = analyzeVertexCache(mesh.faces, mesh.vertices.size());
+	optimizeVertexCache(mesh.faces, mesh.vertices.size());
+	// A mesh that fits in one meshlet gains nothing from being partitioned.
+	if (mesh.faces.size() > MESHLET_MAX_TRIANGLES * VERTICES_PER_FACE) {
+		mesh.meshlets = buildMeshlets(mesh.vertices, mesh.faces);
+	}
+	optimizeVertexFetch(mesh.vertices, mesh.faces);
+	auto after = analyzeVertexCache(mesh.faces, mesh.vertices.size());
 
+	std::cout << "Optimized mesh \"" << name << "\": ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << ", " << mesh.meshlets.size() << " meshlets" << std::endl;
+}
+
+/**
+ * @brief Generates a mesh's chain of simplified levels of detail, each simplified from the one
+ * before it. Must run after optimizeMesh, since the levels index the mesh's final vertex order.
+ */
+void generateLods(MeshData& mesh, const std::vector<float>& lodTargets, const std::string& name) {
+	size_t fullTriangles = mesh.faces.size() / VERTICES_PER_FACE;
+	for (auto target : lodTargets) {
+		const std::vector<uint32_t>& source = mesh.lods.empty() ? mesh.faces : mesh.lods.back().faces;
+		MeshLod lod = simplifyMesh(mesh.vertices, source, static_cast<size_t>(fullTriangles * target));
+		// Once simplification stalls, a further level would cost memory without saving any work.
+		if (lod.faces.size() * 10 > source.size() * 9) {
+			break;
+		}
+		// Each level's error is measured against the one it was simplified from, so they add up.
+		if (!mesh.lods.empty()) {
+			lod.error += mesh.lods.back().error;
+		}
+		optimizeVertexCache(lod.faces, mesh.vertices.size());
+		mesh.lods.push_back(std::move(lod));
+	}
+
+	if (!mesh.lods.empty()) {
+		std::cout << "Generated " << mesh.lods.size() << " LODs for mesh \"" << name << "\": "
+			<< fullTriangles << " triangles";
+		for (auto& lod : mesh.lods) {
+			std::cout << " -> " << lod.faces.size() / VERTICES_PER_FACE << " (error " << lod.error << ")";
+		}
+		std::cout << std::endl;
+	}
+}
+
+uint64_t ImportOptions::hash() const {
+	// occluder is left out: occluders are built from the cooked data, not stored in it.
+	uint64_t hash = fnv1a(lodTargets.data(), lodTargets.size() * sizeof(float));
+	return fnv1a(&mergeStaticMeshes, sizeof(mergeStaticMeshes), hash);
+}
 
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
-	Assimp::Importer importer;
 
-	auto options = aiProcessPreset_TargetRealtime_MaxQuality;
+
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords, const ImportOptions& importOptions) {
+	ModelData model = loadModelData(path, flipTextureCoords, importOptions);
+	return buildObject(model, std::filesystem::path(path), importOptions.occluder);
+}
+
+ModelData loadModelData(const std::filesystem::path& path, bool flipTextureCoords, const ImportOptions& importOptions) {
+	uint32_t options = aiProcessPreset_TargetRealtime_MaxQuality;
 	if (flipTextureCoords) {
 		options |= aiProcess_FlipUVs;
 	}
-	const aiScene* scene = importer.ReadFile(path, options);
+
+	// A warm start reads the cooked model and never touches Assimp.
+	auto cookedPath = cookedModelPath(path);
+	auto key = cookedModelKey(path, options, importOptions.hash());
+	if (auto cooked = loadCookedModel(cookedPath, key)) {
+		return std::move(*cooked);
+	}
+
+	ModelData model = assimpImport(path, options, importOptions);
+	try {
+		saveCookedModel(cookedPath, key, model);
+	}
+	catch (std::exception& e) {
+		// Not being able to cache is no reason to fail the load.
+		std::cerr << "Warning: could not cook " << path << ": " << e.what() << std::endl;
+	}
+	return model;
+}
+
+ModelData assimpImport(const std::filesystem::path& path, uint32_t importFlags, const ImportOptions& options) {
+	Assimp::Importer importer;
+
+	const aiScene* scene = importer.ReadFile(path.string(), importFlags);
 
 	// If the import failed, report it
 	if (nullptr == scene) {
@@ -110,42 +249,193 @@ Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
 		throw std::runtime_error("Error loading assimp file: " + std::string(error));
 
 	}
-	else {
 
+	ModelData model;
+	for (auto i = 0; i < scene->mNumTextures; i++) {
+		model.embeddedTextures.push_back(fromAssimpTexture(scene->mTextures[i], i));
+	}
+	for (auto i = 0; i < scene->mNumMeshes; i++) {
+		model.meshes.push_back(fromAssimpMesh(scene->mMeshes[i], scene));
+	}
+	model.root = processAssimpNode(scene->mRootNode, scene);
+
+	if (options.mergeStaticMeshes) {
+		// Nodes that an animation moves must stay separate; everything else can be flattened.
+		std::unordered_set<std::string> animatedNodes;
+		for (auto a = 0; a < scene->mNumAnimations; a++) {
+			for (auto c = 0; c < scene->mAnimations[a]->mNumChannels; c++) {
+				animatedNodes.insert(scene->mAnimations[a]->mChannels[c]->mNodeName.C_Str());
+			}
+		}
+		size_t drawCallsBefore = countDrawCalls(model.root);
+		mergeStaticMeshes(model, animatedNodes);
+		std::cout << "Merged static meshes of " << path.filename() << ": " << drawCallsBefore << " draw calls -> "
+			<< countDrawCalls(model.root) << std::endl;
+	}
+
+	for (auto& mesh : model.meshes) {
+		optimizeMesh(mesh, mesh.name);
+		mesh.format = chooseVertexFormat(mesh.vertices, mesh.faces);
+		generateLods(mesh, options.lodTargets, mesh.name);
 	}
-	std::vector<Mesh3D> meshes;
-	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
-	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
-	return ret;
+	return model;
 }
 
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
+NodeData processAssimpNode(aiNode* node, const aiScene* scene) {
+	NodeData data;
+	data.name = node->mName.C_Str();
 
-	// Load the aiNode's meshes.
-	std::vector<Mesh3D> meshes;
+	// The aiNode's meshes are indices into the scene's list of meshes.
 	for (auto i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
+		data.meshes.push_back(node->mMeshes[i]);
 	}
 
-	std::vector<Texture> textures;
-	for (auto& p : loadedTextures) {
-		textures.push_back(p.second);
-	}
-	glm::mat4 baseTransform;
 	for (auto i = 0; i < 4; i++) {
 		for (auto j = 0; j < 4; j++) {
-			baseTransform[i][j] = node->mTransformation[j][i];
+			data.baseTransform[i][j] = node->mTransformation[j][i];
 		}
 	}
-	auto parent = Object3D(std::move(meshes), baseTransform);
 
 	for (auto i = 0; i < node->mNumChildren; i++) {
-		Object3D child = processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures);
+		data.children.push_back(processAssimpNode(node->mChildren[i], scene));
+	}
+
+	return data;
+}
+
+/**
+ * @brief Builds the object for a node and its descendants.
+ * @param uploaded the GPU mesh of each of the model's meshes, uploaded the first time a node draws it
+ * and shared by every node after that.
+ */
+Object3D buildNode(const NodeData& node, const ModelData& model, const std::filesystem::path& modelPath,
+	bool occluder, std::vector<std::shared_ptr<Mesh3D>>& uploaded) {
+
+	// Upload the node's meshes, unless another node already has.
+	std::vector<std::shared_ptr<Mesh3D>> meshes;
+	for (auto meshIndex : node.meshes) {
+		if (uploaded[meshIndex] == nullptr) {
+			const MeshData& mesh = model.meshes[meshIndex];
+			std::vector<Texture> textures = loadMaterialTextures(mesh.textures, model, modelPath);
+			uploaded[meshIndex] = std::make_shared<Mesh3D>(std::vector<Vertex3D>(mesh.vertices),
+				std::vector<uint32_t>(mesh.faces), std::move(textures), mesh.format, std::vector<MeshLod>(mesh.lods),
+				std::vector<Meshlet>(mesh.meshlets));
+			if (occluder) {
+				uploaded[meshIndex]->setOccluder(std::make_shared<const OccluderMesh>(buildOccluder(mesh)));
+			}
+		}
+		meshes.push_back(uploaded[meshIndex]);
+	}
+
+	auto parent = Object3D(std::move(meshes), node.baseTransform);
+	parent.setName(node.name);
+
+	for (auto& childNode : node.children) {
+		Object3D child = buildNode(childNode, model, modelPath, occluder, uploaded);
 		parent.addChild(std::move(child));
 	}
 
 	return parent;
 }
+
+/**
+ * @brief Adds how many times the node and its descendants draw each of the model's meshes to counts.
+ */
+static void countMeshReferences(const NodeData& node, std::vector<uint32_t>& counts) {
+	for (auto meshIndex : node.meshes) {
+		counts[meshIndex]++;
+	}
+	for (auto& child : node.children) {
+		countMeshReferences(child, counts);
+	}
+}
+
+std::vector<ImageSource> modelTextureSources(const ModelData& model, const std::filesystem::path& modelPath) {
+	std::vector<ImageSource> sources;
+	for (auto& mesh : model.meshes) {
+		for (auto& ref : mesh.textures) {
+			ImageSource source = textureSource(ref, model, modelPath);
+			if (std::find(sources.begin(), sources.end(), source) == sources.end()) {
+				sources.push_back(source);
+			}
+		}
+	}
+	return sources;
+}
+
+OccluderMesh buildOccluder(const MeshData& mesh) {
+	const std::vector<uint32_t>& faces = mesh.lods.empty() ? mesh.faces : mesh.lods.back().faces;
+
+	// Renumber the vertices in the order the faces first use them, dropping the rest.
+	OccluderMesh occluder;
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	for (uint32_t index : faces) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(occluder.positions.size());
+			auto& v = mesh.vertices[index];
+			occluder.positions.emplace_back(v.x, v.y, v.z);
+		}
+		occluder.indices.push_back(remap[index]);
+	}
+	return occluder;
+}
+
+Object3D buildObject(const ModelData& model, const std::filesystem::path& modelPath, bool occluder) {
+	auto& cache = TextureCache::instance();
+
+	// Collect every texture used by any of the model's meshes that isn't already cached, and decode
+	// them all in parallel before building the hierarchy. Only the upload happens here, on the GL
+	// thread. The textures are held here until the meshes that use them have been built.
+	std::vector<ImageSource> textureSources = modelTextureSources(model, modelPath);
+	std::erase_if(textureSources, [&](auto& source) { return cache.find(source.path, "").has_value(); });
+	std::vector<Texture> decodedTextures;
+	decodeTextures(textureSources, [&](const std::filesystem::path& texPath, StbImage&& image) {
+		decodedTextures.push_back(cache.insert(texPath, image, ""));
+	});
+
+	std::vector<std::shared_ptr<Mesh3D>> uploaded(model.meshes.size());
+	Object3D object = buildNode(model.root, model, modelPath, occluder, uploaded);
+	// Meshes that several nodes draw are drawn instanced.
+	std::vector<uint32_t> references(model.meshes.size());
+	countMeshReferences(model.root, references);
+	for (size_t i = 0; i < uploaded.size(); i++) {
+		if (uploaded[i]) {
+			uploaded[i]->setNodeCount(references[i]);
+		}
+	}
+	std::cout << "Built " << modelPath.filename() << ": " << countDrawCalls(model.root) << " mesh references, "
+		<< std::count_if(uploaded.begin(), uploaded.end(), [](auto& mesh) { return mesh != nullptr; })
+		<< " meshes uploaded" << std::endl;
+	return object;
+}
+
+Task<Object3D> loadModelAsync(std::filesystem::path path, bool flipTextureCoords, ImportOptions options) {
+	co_await resumeOnWorker();
+	ModelData model;
+	std::vector<std::pair<std::filesystem::path, StbImage>> images;
+	std::exception_ptr error;
+	try {
+		model = loadModelData(path, flipTextureCoords, options);
+
+		// The TextureCache belongs to the GL thread, so we can't ask it here which textures are already
+		// loaded. Decode them all; insert() keeps the cache's existing copy of any it already has.
+		decodeTextures(modelTextureSources(model, path), [&](const std::filesystem::path& texPath, StbImage&& image) {
+			images.emplace_back(texPath, std::move(image));
+		});
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	// Whoever awaits this task resumes on the thread that finishes it, so even a failed load has to
+	// finish on the GL thread.
+	co_await resumeOnGLThread();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	std::vector<Texture> textures;
+	for (auto& [texPath, image] : images) {
+		textures.push_back(TextureCache::instance().insert(texPath, image, ""));
+	}
+	co_return buildObject(model, path, options.occluder);
+}
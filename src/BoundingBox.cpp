@@ -0,0 +1,38 @@
+#include "BoundingBox.h"
+#include <limits>
+
+BoundingBox::BoundingBox()
+	: minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max()) {
+}
+
+BoundingBox::BoundingBox(const glm::vec3& minimum, const glm::vec3& maximum)
+	: minimum(minimum), maximum(maximum) {
+}
+
+bool BoundingBox::isEmpty() const {
+	return minimum.x > maximum.x;
+}
+
+void BoundingBox::add(const glm::vec3& point) {
+	minimum = glm::min(minimum, point);
+	maximum = glm::max(maximum, point);
+}
+
+void BoundingBox::add(const BoundingBox& box) {
+	minimum = glm::min(minimum, box.minimum);
+	maximum = glm::max(maximum, box.maximum);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& matrix) const {
+	if (isEmpty()) {
+		return *this;
+	}
+	// Transform the center, and find the extent along each world axis as the sum of the absolute
+	// contributions of the local half-extents (Arvo).
+	glm::vec3 center = glm::vec3(matrix * glm::vec4((minimum + maximum) * 0.5f, 1));
+	glm::vec3 halfExtent = (maximum - minimum) * 0.5f;
+	glm::mat3 linear(matrix);
+	glm::vec3 extent = glm::abs(linear[0]) * halfExtent.x + glm::abs(linear[1]) * halfExtent.y
+		+ glm::abs(linear[2]) * halfExtent.z;
+	return BoundingBox(center - extent, center + extent);
+}
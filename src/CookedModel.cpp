@@ -0,0 +1,271 @@
+#include "CookedModel.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+// Bump whenever the layout below, or the processing that produces a ModelData, changes.
+const uint32_t COOKED_MODEL_VERSION = 8;
+const char COOKED_MODEL_MAGIC[4] = { 'C', 'M', 'D', 'L' };
+// Arrays are aligned so they can be read in place from the mapping.
+const size_t COOKED_ARRAY_ALIGNMENT = 8;
+
+static_assert(std::is_trivially_copyable_v<Vertex3D>, "Vertex3D is copied as raw bytes");
+static_assert(sizeof(Vertex3D) == 8 * sizeof(float), "Vertex3D must not contain padding");
+static_assert(std::is_trivially_copyable_v<Meshlet>, "Meshlet is copied as raw bytes");
+
+struct CookedHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t importFlags;
+	uint32_t meshCount;
+	uint64_t optionsHash;
+	uint32_t embeddedTextureCount;
+};
+
+/**
+ * @brief Appends the cooked representation of a model to an in-memory buffer.
+ */
+class CookedWriter {
+	std::vector<unsigned char> m_bytes;
+
+public:
+	const std::vector<unsigned char>& bytes() const { return m_bytes; }
+
+	void write(const void* data, size_t size) {
+		auto bytes = static_cast<const unsigned char*>(data);
+		m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void write(const T& value) {
+		write(&value, sizeof(T));
+	}
+
+	void writeString(const std::string& value) {
+		write(static_cast<uint32_t>(value.size()));
+		write(value.data(), value.size());
+	}
+
+	template <typename T>
+	void writeArray(const std::vector<T>& values) {
+		write(static_cast<uint32_t>(values.size()));
+		m_bytes.resize((m_bytes.size() + COOKED_ARRAY_ALIGNMENT - 1) / COOKED_ARRAY_ALIGNMENT * COOKED_ARRAY_ALIGNMENT);
+		write(values.data(), values.size() * sizeof(T));
+	}
+
+	/**
+	 * @brief Writes a mesh's indices in 16 bits if they all fit, else in 32 bits.
+	 */
+	void writeIndices(const std::vector<uint32_t>& faces, size_t vertexCount) {
+		if (vertexCount <= UINT16_MAX + 1) {
+			write(static_cast<uint32_t>(sizeof(uint16_t)));
+			writeArray(std::vector<uint16_t>(faces.begin(), faces.end()));
+		}
+		else {
+			write(static_cast<uint32_t>(sizeof(uint32_t)));
+			writeArray(faces);
+		}
+	}
+
+	void writeNode(const NodeData& node) {
+		writeString(node.name);
+		write(node.baseTransform);
+		writeArray(node.meshes);
+		write(static_cast<uint32_t>(node.children.size()));
+		for (auto& child : node.children) {
+			writeNode(child);
+		}
+	}
+};
+
+/**
+ * @brief Reads a cooked model out of a memory mapping. Throws if the data runs out early.
+ */
+class CookedReader {
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_offset;
+
+	const unsigned char* take(size_t size) {
+		if (size > m_size - m_offset) {
+			throw std::runtime_error("Cooked model is truncated");
+		}
+		auto start = m_data + m_offset;
+		m_offset += size;
+		return start;
+	}
+
+public:
+	CookedReader(const unsigned char* data, size_t size) : m_data(data), m_size(size), m_offset(0) {
+	}
+
+	template <typename T>
+	T read() {
+		T value;
+		std::memcpy(&value, take(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	std::string readString() {
+		auto length = read<uint32_t>();
+		auto start = reinterpret_cast<const char*>(take(length));
+		return std::string(start, start + length);
+	}
+
+	template <typename T>
+	std::vector<T> readArray() {
+		auto count = read<uint32_t>();
+		size_t aligned = (m_offset + COOKED_ARRAY_ALIGNMENT - 1) / COOKED_ARRAY_ALIGNMENT * COOKED_ARRAY_ALIGNMENT;
+		take(aligned - m_offset);
+		auto start = reinterpret_cast<const T*>(take(count * sizeof(T)));
+		return std::vector<T>(start, start + count);
+	}
+
+	std::vector<uint32_t> readIndices() {
+		if (read<uint32_t>() == sizeof(uint16_t)) {
+			auto narrowFaces = readArray<uint16_t>();
+			return std::vector<uint32_t>(narrowFaces.begin(), narrowFaces.end());
+		}
+		return readArray<uint32_t>();
+	}
+
+	NodeData readNode() {
+		NodeData node;
+		node.name = readString();
+		node.baseTransform = read<glm::mat4>();
+		node.meshes = readArray<uint32_t>();
+		auto childCount = read<uint32_t>();
+		for (uint32_t i = 0; i < childCount; i++) {
+			node.children.push_back(readNode());
+		}
+		return node;
+	}
+};
+
+std::filesystem::path cookedModelPath(const std::filesystem::path& modelPath) {
+	auto path = modelPath;
+	path += ".cooked";
+	return path;
+}
+
+CookedModelKey cookedModelKey(const std::filesystem::path& modelPath, uint32_t importFlags, uint64_t optionsHash) {
+	MappedFile source;
+	uint64_t hash = 0;
+	if (source.open(modelPath)) {
+		hash = fnv1a(source.data(), source.size());
+	}
+	return CookedModelKey{ hash, importFlags, optionsHash };
+}
+
+std::optional<ModelData> loadCookedModel(const std::filesystem::path& cookedPath, const CookedModelKey& key) {
+	MappedFile file;
+	if (!file.open(cookedPath)) {
+		return std::nullopt;
+	}
+
+	try {
+		CookedReader reader(file.data(), file.size());
+		auto header = reader.read<CookedHeader>();
+		if (std::memcmp(header.magic, COOKED_MODEL_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != COOKED_MODEL_VERSION
+			|| header.sourceHash != key.sourceHash
+			|| header.importFlags != key.importFlags
+			|| header.optionsHash != key.optionsHash) {
+			return std::nullopt;
+		}
+
+		ModelData model;
+		model.meshes.reserve(header.meshCount);
+		for (uint32_t i = 0; i < header.meshCount; i++) {
+			MeshData mesh;
+			mesh.name = reader.readString();
+			auto textureCount = reader.read<uint32_t>();
+			for (uint32_t t = 0; t < textureCount; t++) {
+				TextureRef texture;
+				texture.samplerName = reader.readString();
+				texture.name = reader.readString();
+				texture.embeddedTexture = reader.read<int32_t>();
+				mesh.textures.push_back(std::move(texture));
+			}
+			mesh.format = static_cast<VertexFormat>(reader.read<uint32_t>());
+			mesh.vertices = reader.readArray<Vertex3D>();
+			mesh.faces = reader.readIndices();
+			auto lodCount = reader.read<uint32_t>();
+			for (uint32_t l = 0; l < lodCount; l++) {
+				MeshLod lod;
+				lod.error = reader.read<float>();
+				lod.faces = reader.readIndices();
+				mesh.lods.push_back(std::move(lod));
+			}
+			mesh.meshlets = reader.readArray<Meshlet>();
+			model.meshes.push_back(std::move(mesh));
+		}
+		for (uint32_t i = 0; i < header.embeddedTextureCount; i++) {
+			EmbeddedTexture texture;
+			texture.name = reader.readString();
+			texture.width = reader.read<uint32_t>();
+			texture.height = reader.read<uint32_t>();
+			texture.data = reader.readArray<unsigned char>();
+			model.embeddedTextures.push_back(std::move(texture));
+		}
+		model.root = reader.readNode();
+		return model;
+	}
+	catch (std::runtime_error&) {
+		return std::nullopt;
+	}
+}
+
+void saveCookedModel(const std::filesystem::path& cookedPath, const CookedModelKey& key, const ModelData& model) {
+	CookedWriter writer;
+	CookedHeader header{};
+	std::memcpy(header.magic, COOKED_MODEL_MAGIC, sizeof(header.magic));
+	header.version = COOKED_MODEL_VERSION;
+	header.sourceHash = key.sourceHash;
+	header.importFlags = key.importFlags;
+	header.meshCount = static_cast<uint32_t>(model.meshes.size());
+	header.optionsHash = key.optionsHash;
+	header.embeddedTextureCount = static_cast<uint32_t>(model.embeddedTextures.size());
+	writer.write(header);
+
+	for (auto& mesh : model.meshes) {
+		writer.writeString(mesh.name);
+		writer.write(static_cast<uint32_t>(mesh.textures.size()));
+		for (auto& texture : mesh.textures) {
+			writer.writeString(texture.samplerName);
+			writer.writeString(texture.name);
+			writer.write(texture.embeddedTexture);
+		}
+		writer.write(static_cast<uint32_t>(mesh.format));
+		writer.writeArray(mesh.vertices);
+		writer.writeIndices(mesh.faces, mesh.vertices.size());
+		writer.write(static_cast<uint32_t>(mesh.lods.size()));
+		for (auto& lod : mesh.lods) {
+			writer.write(lod.error);
+			writer.writeIndices(lod.faces, mesh.vertices.size());
+		}
+		writer.writeArray(mesh.meshlets);
+	}
+	for (auto& texture : model.embeddedTextures) {
+		writer.writeString(texture.name);
+		writer.write(texture.width);
+		writer.write(texture.height);
+		writer.writeArray(texture.data);
+	}
+	writer.writeNode(model.root);
+
+	auto tempPath = cookedPath;
+	tempPath += ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(writer.bytes().data()), writer.bytes().size());
+		if (!out) {
+			throw std::runtime_error("Could not write cooked model " + tempPath.string());
+		}
+	}
+	std::filesystem::rename(tempPath, cookedPath);
+}
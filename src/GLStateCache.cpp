@@ -0,0 +1,87 @@
+#include "GLStateCache.h"
+#include <glad/glad.h>
+
+GLStateCache::GLStateCache() {
+	invalidate();
+}
+
+GLStateCache& GLStateCache::instance() {
+	static GLStateCache cache;
+	return cache;
+}
+
+bool GLStateCache::changes(uint32_t& current, uint32_t value) {
+	if (current == value) {
+		m_stats.elided++;
+		return false;
+	}
+	current = value;
+	m_stats.issued++;
+	return true;
+}
+
+void GLStateCache::useProgram(uint32_t program) {
+	if (changes(m_program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void GLStateCache::bindVertexArray(uint32_t vertexArray) {
+	if (changes(m_vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void GLStateCache::bindTexture(uint32_t unit, uint32_t texture) {
+	if (unit >= m_textures.size()) {
+		m_textures.resize(unit + 1, UNKNOWN);
+	}
+	if (m_textures[unit] == texture) {
+		m_stats.elided++;
+		return;
+	}
+	if (changes(m_activeUnit, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	changes(m_textures[unit], texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLStateCache::setSampler(ShaderProgram& program, UniformHandle sampler, int32_t unit) {
+	if (!sampler.isValid()) {
+		return;
+	}
+	auto& samplers = m_samplers[program.getId()];
+	auto current = samplers.find(sampler.location);
+	if (current != samplers.end() && current->second == unit) {
+		m_stats.elided++;
+		return;
+	}
+	samplers[sampler.location] = unit;
+	m_stats.issued++;
+	program.setUniform(sampler, unit);
+}
+
+void GLStateCache::textureDeleted(uint32_t texture) {
+	for (auto& bound : m_textures) {
+		if (bound == texture) {
+			bound = 0;
+		}
+	}
+}
+
+void GLStateCache::invalidate() {
+	m_program = UNKNOWN;
+	m_vertexArray = UNKNOWN;
+	m_activeUnit = UNKNOWN;
+	m_textures.clear();
+	m_samplers.clear();
+}
+
+const GLStateStats& GLStateCache::stats() const {
+	return m_stats;
+}
+
+void GLStateCache::resetStats() {
+	m_stats = GLStateStats();
+}
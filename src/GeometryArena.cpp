@@ -0,0 +1,261 @@
+#include "GeometryArena.h"
+#include "InstanceBatch.h"
+#include "GLStateCache.h"
+#include "IndirectRenderer.h"
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+
+// The initial size of each of the arena's buffers. Buffers at least double when they grow.
+const size_t GEOMETRY_ARENA_INITIAL_BYTES = 4 << 20;
+// Index ranges start on a multiple of the largest index size, so either index type can be read.
+const size_t GEOMETRY_INDEX_ALIGNMENT = sizeof(uint32_t);
+
+FreeListAllocator::FreeListAllocator(size_t capacity) : m_capacity(capacity), m_used(0) {
+	if (capacity > 0) {
+		m_free.push_back(Block{ 0, capacity });
+	}
+}
+
+std::optional<size_t> FreeListAllocator::allocate(size_t size, size_t alignment) {
+	for (size_t i = 0; i < m_free.size(); i++) {
+		Block block = m_free[i];
+		size_t start = (block.offset + alignment - 1) / alignment * alignment;
+		if (start + size > block.offset + block.size) {
+			continue;
+		}
+
+		// Carve the range out of the block, keeping whatever is left on either side of it free.
+		m_free.erase(m_free.begin() + i);
+		size_t end = start + size;
+		if (end < block.offset + block.size) {
+			m_free.insert(m_free.begin() + i, Block{ end, block.offset + block.size - end });
+		}
+		if (start > block.offset) {
+			m_free.insert(m_free.begin() + i, Block{ block.offset, start - block.offset });
+		}
+		m_used += size;
+		return start;
+	}
+	return std::nullopt;
+}
+
+void FreeListAllocator::free(size_t offset, size_t size) {
+	m_used -= size;
+	auto next = std::lower_bound(m_free.begin(), m_free.end(), offset,
+		[](const Block& block, size_t offset) { return block.offset < offset; });
+	next = m_free.insert(next, Block{ offset, size });
+
+	// Merge with the following block, then with the preceding one.
+	if (next + 1 != m_free.end() && next->offset + next->size == (next + 1)->offset) {
+		next->size += (next + 1)->size;
+		m_free.erase(next + 1);
+	}
+	if (next != m_free.begin() && (next - 1)->offset + (next - 1)->size == next->offset) {
+		(next - 1)->size += next->size;
+		m_free.erase(next);
+	}
+}
+
+void FreeListAllocator::grow(size_t newCapacity) {
+	size_t added = newCapacity - m_capacity;
+	m_capacity = newCapacity;
+	// free() coalesces the new room with a free block at the old end, if there is one.
+	m_used += added;
+	free(newCapacity - added, added);
+}
+
+size_t FreeListAllocator::capacity() const {
+	return m_capacity;
+}
+
+size_t FreeListAllocator::used() const {
+	return m_used;
+}
+
+size_t FreeListAllocator::freeBlockCount() const {
+	return m_free.size();
+}
+
+size_t FreeListAllocator::largestFreeBlock() const {
+	size_t largest = 0;
+	for (auto& block : m_free) {
+		largest = std::max(largest, block.size);
+	}
+	return largest;
+}
+
+GeometryAllocation::~GeometryAllocation() {
+	GeometryArena::instance().free(*this);
+}
+
+float GeometryBufferStats::utilization() const {
+	return capacityBytes == 0 ? 0 : float(usedBytes) / capacityBytes;
+}
+
+float GeometryBufferStats::fragmentation() const {
+	size_t freeBytes = capacityBytes - usedBytes;
+	return freeBytes == 0 ? 0 : 1 - float(largestFreeBlockBytes) / freeBytes;
+}
+
+GeometryArena::GeometryArena() : m_indices(GEOMETRY_ARENA_INITIAL_BYTES) {
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+	glBufferData(GL_COPY_WRITE_BUFFER, GEOMETRY_ARENA_INITIAL_BYTES, nullptr, GL_STATIC_DRAW);
+}
+
+GeometryArena& GeometryArena::instance() {
+	static GeometryArena arena;
+	return arena;
+}
+
+GeometryArena::VertexPool& GeometryArena::pool(VertexFormat format) {
+	auto existing = m_pools.find(format);
+	if (existing != m_pools.end()) {
+		return existing->second;
+	}
+
+	size_t vertexCapacity = GEOMETRY_ARENA_INITIAL_BYTES / vertexStride(format);
+	VertexPool pool{ 0, 0, 0, FreeListAllocator(vertexCapacity) };
+	glGenBuffers(1, &pool.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * vertexStride(format), nullptr, GL_STATIC_DRAW);
+
+	// The vertex array records the format's attribute layout in the pool's buffer, the shared
+	// instance attributes, and the shared index buffer.
+	glGenVertexArrays(1, &pool.vao);
+	GLStateCache::instance().bindVertexArray(pool.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+	setVertexAttributes(format);
+	InstanceBuffer::instance().attach();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	GLStateCache::instance().bindVertexArray(0);
+
+	return m_pools.emplace(format, std::move(pool)).first->second;
+}
+
+uint32_t GeometryArena::resizeBuffer(uint32_t buffer, size_t oldSize, size_t newSize) {
+	uint32_t resized;
+	glGenBuffers(1, &resized);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+	glDeleteBuffers(1, &buffer);
+	return resized;
+}
+
+void GeometryArena::growVertices(VertexFormat format, VertexPool& pool, size_t minimumVertices) {
+	size_t oldCapacity = pool.allocator.capacity();
+	size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + minimumVertices);
+	pool.vbo = resizeBuffer(pool.vbo, oldCapacity * vertexStride(format), newCapacity * vertexStride(format));
+	pool.allocator.grow(newCapacity);
+
+	// Point the vertex arrays' attributes at the new buffer.
+	for (uint32_t vao : { pool.vao, pool.indirectVao }) {
+		if (vao != 0) {
+			GLStateCache::instance().bindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+			setVertexAttributes(format);
+		}
+	}
+	GLStateCache::instance().bindVertexArray(0);
+}
+
+void GeometryArena::growIndices(size_t minimumBytes) {
+	size_t oldCapacity = m_indices.capacity();
+	size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + minimumBytes + GEOMETRY_INDEX_ALIGNMENT);
+	m_ebo = resizeBuffer(m_ebo, oldCapacity, newCapacity);
+	m_indices.grow(newCapacity);
+
+	// Every vertex array shares the index buffer.
+	for (auto& [format, pool] : m_pools) {
+		for (uint32_t vao : { pool.vao, pool.indirectVao }) {
+			if (vao != 0) {
+				GLStateCache::instance().bindVertexArray(vao);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+			}
+		}
+	}
+	GLStateCache::instance().bindVertexArray(0);
+}
+
+std::shared_ptr<const GeometryAllocation> GeometryArena::allocate(VertexFormat format, const void* vertices,
+	size_t vertexCount, const void* indices, size_t indexBytes) {
+	VertexPool& vertexPool = pool(format);
+	auto firstVertex = vertexPool.allocator.allocate(vertexCount);
+	if (!firstVertex) {
+		growVertices(format, vertexPool, vertexCount);
+		firstVertex = vertexPool.allocator.allocate(vertexCount);
+	}
+	auto indexOffset = m_indices.allocate(indexBytes, GEOMETRY_INDEX_ALIGNMENT);
+	if (!indexOffset) {
+		growIndices(indexBytes);
+		indexOffset = m_indices.allocate(indexBytes, GEOMETRY_INDEX_ALIGNMENT);
+	}
+
+	// Upload through the copy target, which no vertex array records.
+	size_t stride = vertexStride(format);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexPool.vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, *firstVertex * stride, vertexCount * stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, *indexOffset, indexBytes, indices);
+
+	return std::shared_ptr<const GeometryAllocation>(
+		new GeometryAllocation{ format, *firstVertex, vertexCount, *indexOffset, indexBytes });
+}
+
+void GeometryArena::free(const GeometryAllocation& allocation) {
+	pool(allocation.format).allocator.free(allocation.firstVertex, allocation.vertexCount);
+	m_indices.free(allocation.indexOffset, allocation.indexBytes);
+}
+
+uint32_t GeometryArena::vertexArray(VertexFormat format) {
+	return pool(format).vao;
+}
+
+uint32_t GeometryArena::indirectVertexArray(VertexFormat format) {
+	VertexPool& vertexPool = pool(format);
+	if (vertexPool.indirectVao == 0) {
+		glGenVertexArrays(1, &vertexPool.indirectVao);
+		GLStateCache::instance().bindVertexArray(vertexPool.indirectVao);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexPool.vbo);
+		setVertexAttributes(format);
+		DrawIndexBuffer::instance().attach();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		GLStateCache::instance().bindVertexArray(0);
+	}
+	return vertexPool.indirectVao;
+}
+
+static const char* vertexFormatName(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Float32:
+		return "Float32 vertices";
+	case VertexFormat::PackedAttributes:
+		return "PackedAttributes vertices";
+	case VertexFormat::Quantized:
+		return "Quantized vertices";
+	}
+	return "vertices";
+}
+
+std::vector<GeometryBufferStats> GeometryArena::stats() const {
+	std::vector<GeometryBufferStats> stats;
+	for (auto& [format, pool] : m_pools) {
+		size_t stride = vertexStride(format);
+		stats.push_back(GeometryBufferStats{ vertexFormatName(format), pool.allocator.capacity() * stride,
+			pool.allocator.used() * stride, pool.allocator.freeBlockCount(), pool.allocator.largestFreeBlock() * stride });
+	}
+	stats.push_back(GeometryBufferStats{ "indices", m_indices.capacity(), m_indices.used(),
+		m_indices.freeBlockCount(), m_indices.largestFreeBlock() });
+	return stats;
+}
+
+void GeometryArena::printStats() const {
+	for (auto& buffer : stats()) {
+		std::cout << "Geometry arena " << buffer.name << ": " << buffer.usedBytes << " / " << buffer.capacityBytes
+			<< " bytes used (" << buffer.utilization() * 100 << "%), " << buffer.freeBlocks << " free blocks, "
+			<< buffer.fragmentation() * 100 << "% fragmented" << std::endl;
+	}
+}
@@ -0,0 +1,137 @@
+#include "IndirectRenderer.h"
+#include "Mesh3D.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <numeric>
+#include <glad/glad.h>
+
+// Enough draws for most scenes, before the draw index buffer first has to grow.
+const uint32_t DRAW_INDEX_INITIAL_COUNT = 1024;
+
+DrawIndexBuffer::DrawIndexBuffer() : m_count(0) {
+	glGenBuffers(1, &m_buffer);
+	reserve(DRAW_INDEX_INITIAL_COUNT);
+}
+
+DrawIndexBuffer& DrawIndexBuffer::instance() {
+	static DrawIndexBuffer buffer;
+	return buffer;
+}
+
+void DrawIndexBuffer::attach() const {
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	glVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+	glEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+	glVertexAttribDivisor(DRAW_INDEX_LOCATION, 1);
+}
+
+void DrawIndexBuffer::reserve(uint32_t count) {
+	if (count <= m_count) {
+		return;
+	}
+	// Respecifying the same buffer object keeps every vertex array that attached it pointing at it.
+	m_count = std::max(count, m_count * 2);
+	std::vector<uint32_t> indices(m_count);
+	std::iota(indices.begin(), indices.end(), 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+}
+
+bool IndirectRenderer::supported() {
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+IndirectRenderer::IndirectRenderer() {
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_drawBuffer);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+	glDeleteBuffers(1, &m_commandBuffer);
+	glDeleteBuffers(1, &m_drawBuffer);
+}
+
+IndirectRenderer::Bucket& IndirectRenderer::bucket(const Mesh3D& mesh) {
+	uint32_t vao = mesh.indirectVertexArray();
+	auto& textures = mesh.getTextures();
+	auto existing = std::find_if(m_buckets.begin(), m_buckets.end(), [&](const Bucket& b) {
+		return b.vao == vao && b.indexType == mesh.indexType() && b.textureIds.size() == textures.size()
+			&& std::equal(textures.begin(), textures.end(), b.textureIds.begin(),
+				[](const Texture& t, uint32_t id) { return t.textureId == id; });
+	});
+	if (existing != m_buckets.end()) {
+		return *existing;
+	}
+
+	Bucket added{ vao, mesh.indexType(), {}, &mesh, {}, nullptr, 0 };
+	for (auto& texture : textures) {
+		added.textureIds.push_back(texture.textureId);
+	}
+	m_buckets.push_back(std::move(added));
+	return m_buckets.back();
+}
+
+void IndirectRenderer::add(const Mesh3D& mesh, size_t lod, const glm::mat4& model, const glm::vec4& material) {
+	uint32_t drawIndex = static_cast<uint32_t>(m_draws.size());
+	const PositionQuantization& quantization = mesh.quantization();
+	m_draws.push_back(IndirectDrawData{ model, material, glm::vec4(quantization.scale, 0),
+		glm::vec4(quantization.offset, 0) });
+
+	// Another draw of the previous command's mesh becomes another instance of that command, as
+	// long as its draw data directly follows the command's.
+	Bucket& target = bucket(mesh);
+	if (target.lastMesh == &mesh && target.lastLod == lod) {
+		auto& last = target.commands.back();
+		if (last.baseInstance + last.instanceCount == drawIndex) {
+			last.instanceCount++;
+			return;
+		}
+	}
+	DrawElementsIndirectCommand command = mesh.indirectCommand(lod);
+	command.baseInstance = drawIndex;
+	target.commands.push_back(command);
+	target.lastMesh = &mesh;
+	target.lastLod = lod;
+}
+
+void IndirectRenderer::flush(ShaderProgram& program, const RenderView* view) {
+	if (m_draws.empty()) {
+		return;
+	}
+
+	m_commands.clear();
+	for (auto& b : m_buckets) {
+		m_commands.insert(m_commands.end(), b.commands.begin(), b.commands.end());
+	}
+	// Orphan both buffers before refilling them, so the uploads never wait for the last frame's draws.
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand), nullptr,
+		GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DrawElementsIndirectCommand),
+		m_commands.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_draws.size() * sizeof(IndirectDrawData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_draws.size() * sizeof(IndirectDrawData), m_draws.data());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAWS_BINDING, m_drawBuffer);
+	DrawIndexBuffer::instance().reserve(static_cast<uint32_t>(m_draws.size()));
+
+	size_t firstCommand = 0;
+	for (auto& b : m_buckets) {
+		GLStateCache::instance().bindVertexArray(b.vao);
+		b.textureSource->bindTextures(program);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, b.indexType,
+			reinterpret_cast<const void*>(firstCommand * sizeof(DrawElementsIndirectCommand)),
+			static_cast<GLsizei>(b.commands.size()), 0);
+		firstCommand += b.commands.size();
+
+		if (view) {
+			view->stats.drawCalls++;
+			for (auto& command : b.commands) {
+				view->stats.trianglesSubmitted += command.count / 3 * command.instanceCount;
+			}
+		}
+	}
+
+	m_buckets.clear();
+	m_draws.clear();
+}
@@ -0,0 +1,62 @@
+#include "InstanceBatch.h"
+#include "Mesh3D.h"
+#include <algorithm>
+#include <cstddef>
+#include <glad/glad.h>
+
+InstanceBuffer::InstanceBuffer() {
+	glGenBuffers(1, &m_buffer);
+	// Every vertex array reads instance 0 from the buffer even in draws that aren't instanced, and
+	// those draws ignore it, but it has to exist. Only batches of at least one instance are
+	// uploaded later, so the buffer is never empty.
+	upload({ InstanceData{ glm::mat4(1), glm::vec4(0.1, 1.0, 0.3, 4) } });
+}
+
+InstanceBuffer& InstanceBuffer::instance() {
+	static InstanceBuffer buffer;
+	return buffer;
+}
+
+void InstanceBuffer::attach() const {
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	// A mat4 attribute occupies four consecutive locations, one per column.
+	for (uint32_t column = 0; column < 4; column++) {
+		glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, false, sizeof(InstanceData),
+			reinterpret_cast<void*>(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+		glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+	}
+	glVertexAttribPointer(INSTANCE_MATERIAL_LOCATION, 4, GL_FLOAT, false, sizeof(InstanceData),
+		reinterpret_cast<void*>(offsetof(InstanceData, material)));
+	glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+	glVertexAttribDivisor(INSTANCE_MATERIAL_LOCATION, 1);
+}
+
+void InstanceBuffer::upload(const std::vector<InstanceData>& instances) const {
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+}
+
+void InstanceBatcher::add(const Mesh3D& mesh, size_t lod, const glm::mat4& model, const glm::vec4& material) {
+	auto batch = std::find_if(m_batches.begin(), m_batches.end(), [&](const Batch& b) {
+		return b.mesh == &mesh && b.lod == lod;
+	});
+	if (batch == m_batches.end()) {
+		m_batches.push_back(Batch{ &mesh, lod });
+		batch = m_batches.end() - 1;
+	}
+	batch->instances.push_back(InstanceData{ model, material });
+}
+
+void InstanceBatcher::flush(ShaderProgram& program, const RenderView* view) {
+	for (auto& batch : m_batches) {
+		if (view) {
+			batch.mesh->renderInstanced(program, *view, batch.lod, batch.instances);
+		}
+		else {
+			batch.mesh->renderInstanced(program, batch.lod, batch.instances);
+		}
+	}
+	m_batches.clear();
+}
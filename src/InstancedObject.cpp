@@ -0,0 +1,95 @@
+#include "InstancedObject.h"
+
+InstancedObject::InstancedObject(const Object3D& prototype)
+	: m_dirty(false) {
+	addParts(prototype, glm::mat4(1));
+}
+
+void InstancedObject::addParts(const Object3D& object, const glm::mat4& parentMatrix) {
+	glm::mat4 transform = parentMatrix * object.getLocalMatrix();
+	for (auto& mesh : object.getMeshes()) {
+		m_parts.push_back(Part{ mesh, transform });
+	}
+	for (size_t i = 0; i < object.numberOfChildren(); i++) {
+		addParts(object.getChild(i), transform);
+	}
+}
+
+void InstancedObject::updateParts() const {
+	if (!m_dirty) {
+		return;
+	}
+	for (auto& part : m_parts) {
+		part.instances.resize(m_instances.size());
+		for (size_t i = 0; i < m_instances.size(); i++) {
+			part.instances[i] = InstanceData{ m_instances[i].model * part.transform, m_instances[i].material };
+		}
+	}
+	m_dirty = false;
+}
+
+size_t InstancedObject::addInstance(const glm::mat4& transform, const glm::vec4& material) {
+	m_instances.push_back(InstanceData{ transform, material });
+	m_dirty = true;
+	return m_instances.size() - 1;
+}
+
+size_t InstancedObject::instanceCount() const {
+	return m_instances.size();
+}
+
+void InstancedObject::clearInstances() {
+	m_instances.clear();
+	m_dirty = true;
+}
+
+const glm::mat4& InstancedObject::getTransform(size_t index) const {
+	return m_instances[index].model;
+}
+
+const glm::vec4& InstancedObject::getMaterial(size_t index) const {
+	return m_instances[index].material;
+}
+
+void InstancedObject::setTransform(size_t index, const glm::mat4& transform) {
+	m_instances[index].model = transform;
+	m_dirty = true;
+}
+
+void InstancedObject::setMaterial(size_t index, const glm::vec4& material) {
+	m_instances[index].material = material;
+	m_dirty = true;
+}
+
+void InstancedObject::render(ShaderProgram& program) const {
+	updateParts();
+	for (auto& part : m_parts) {
+		if (!part.instances.empty()) {
+			part.mesh->renderInstanced(program, 0, part.instances);
+		}
+	}
+}
+
+void InstancedObject::render(ShaderProgram& program, const RenderView& view) const {
+	updateParts();
+	InstanceBatcher visible;
+	for (auto& part : m_parts) {
+		for (auto& instance : part.instances) {
+			if (part.mesh->inView(view, instance.model)) {
+				visible.add(*part.mesh, part.mesh->selectLod(view, instance.model), instance.model, instance.material);
+			}
+		}
+	}
+	visible.flush(program, &view);
+}
+
+void InstancedObject::render(const RenderView& view, IndirectRenderer& indirect) const {
+	updateParts();
+	for (auto& part : m_parts) {
+		for (auto& instance : part.instances) {
+			if (part.mesh->inView(view, instance.model)) {
+				indirect.add(*part.mesh, part.mesh->selectLod(view, instance.model), instance.model, instance.material);
+			}
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr) {
+}
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0) {
+}
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+#ifdef _WIN32
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::filesystem::path& path) {
+	close();
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	// Windows can't map an empty file; an empty mapping is still a successful open.
+	if (m_size == 0) {
+		return true;
+	}
+
+	m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		close();
+		return false;
+	}
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+#else
+bool MappedFile::open(const std::filesystem::path& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		return false;
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size == 0) {
+		::close(fd);
+		return true;
+	}
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file alive; we don't need the descriptor any more.
+	::close(fd);
+	if (data == MAP_FAILED) {
+		m_size = 0;
+		return false;
+	}
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const unsigned char*>(data);
+	return true;
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr) {
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	}
+	m_data = nullptr;
+	m_size = 0;
+}
+#endif
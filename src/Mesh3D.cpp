@@ -1,5 +1,7 @@
 #include <iostream>
+#include <algorithm>
 #include "Mesh3D.h"
+#include "GLStateCache.h"
 #include <glad/glad.h>
 
 
@@ -8,63 +10,327 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	: Mesh3D(std::move(vertices), std::move(faces), std::vector<Texture>{texture}) {
 }
 
-Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
-	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
+Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures,
+	VertexFormat format, std::vector<MeshLod>&& lods, std::vector<Meshlet>&& meshlets)
+	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures),
+	m_indexType(GL_UNSIGNED_INT), m_meshlets(std::move(meshlets)), m_format(format), m_quantization(PositionQuantization{ glm::vec3(1), glm::vec3(0) }),
+	m_nodeCount(1), m_uniformProgram(0) {
+	if (m_format == VertexFormat::Quantized) {
+		m_quantization = positionQuantization(vertices);
+	}
 
-	// Generate a vertex array object on the GPU.
-	glGenVertexArrays(1, &m_vao);
-	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(m_vao);
+	// Bound the mesh with a box, for culling scene nodes, and a sphere around the center of the box,
+	// to estimate how far it is from the camera when choosing a level of detail.
+	for (auto& v : vertices) {
+		m_bounds.add(glm::vec3(v.x, v.y, v.z));
+	}
+	m_boundsCenter = m_bounds.isEmpty() ? glm::vec3(0) : (m_bounds.minimum + m_bounds.maximum) * 0.5f;
+	m_boundsRadius = 0;
+	for (auto& v : vertices) {
+		m_boundsRadius = std::max(m_boundsRadius, glm::length(glm::vec3(v.x, v.y, v.z) - m_boundsCenter));
+	}
 
-	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
+	// Encode the vertices in the mesh's vertex format, if it isn't plain floats.
+	std::vector<unsigned char> encoded;
+	const void* vertexData = vertices.data();
+	if (m_format != VertexFormat::Float32) {
+		encoded = encodeVertices(vertices, m_format, m_quantization);
+		vertexData = encoded.data();
+	}
 
-	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// This vbo is now associated with m_vao.
-	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
-	// Inform OpenGL how to interpret the buffer: each vertex is 3 floats for position...
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex3D), 0);
-	glEnableVertexAttribArray(0);
+	// The mesh's indices, followed by the indices of each of its levels of detail.
+	m_lods.push_back(LodRange{ 0, m_faceCount, 0 });
+	for (auto& lod : lods) {
+		m_lods.push_back(LodRange{ faces.size(), static_cast<uint32_t>(lod.faces.size()), lod.error });
+		faces.insert(faces.end(), lod.faces.begin(), lod.faces.end());
+	}
+	// If every index fits in 16 bits, store them that way: half the memory, and half the bandwidth
+	// to fetch them.
+	std::vector<uint16_t> narrowFaces;
+	const void* indexData = faces.data();
+	size_t indexSize = sizeof(uint32_t);
+	if (m_vertexCount <= UINT16_MAX + 1) {
+		narrowFaces.assign(faces.begin(), faces.end());
+		indexData = narrowFaces.data();
+		m_indexType = GL_UNSIGNED_SHORT;
+		indexSize = sizeof(uint16_t);
+	}
 
-	// Inform OpenGL how to interpret the buffer: ... then 3 floats for normal vector...
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex3D), (void*)12);
-	glEnableVertexAttribArray(1);
+	// Copy the vertices and indices into the shared geometry buffers, where the mesh is drawn
+	// with the vertex array shared by every mesh of its format.
+	m_geometry = GeometryArena::instance().allocate(m_format, vertexData, m_vertexCount, indexData,
+		faces.size() * indexSize);
+	m_vao = GeometryArena::instance().vertexArray(m_format);
+	m_baseVertex = static_cast<GLint>(m_geometry->firstVertex);
+	// The ranges were recorded in indices; the draw calls want byte offsets into the shared buffer.
+	for (auto& range : m_lods) {
+		range.offset = m_geometry->indexOffset + range.offset * indexSize;
+	}
+}
 
-	// Inform OpenGL how to interpret the buffer: ... the 2 floats for texture coordinate.
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex3D), (void*)24);
-	glEnableVertexAttribArray(2);
+void Mesh3D::addTexture(Texture texture) {
+	m_textures.push_back(texture);
+	m_uniformProgram = 0;
+}
 
+void Mesh3D::render(ShaderProgram& program) const {
+	renderLod(program, 0);
+}
 
-	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+void Mesh3D::render(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const {
+	if (inView(view, model)) {
+		renderInView(program, view, model);
+	}
+}
 
-	// Unbind the vertex array, so no one else can accidentally mess with it.
-	glBindVertexArray(0);
+void Mesh3D::renderInView(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const {
+	size_t lod = selectLod(view, model);
+	if (lod == 0 && m_meshlets.size() > 1) {
+		renderMeshlets(program, view, model);
+	}
+	else {
+		renderLod(program, lod);
+		view.stats.trianglesSubmitted += triangleCount(lod);
+		view.stats.drawCalls++;
+	}
 }
 
-void Mesh3D::addTexture(Texture texture) {
-	m_textures.push_back(texture);
+bool Mesh3D::inView(const RenderView& view, const glm::mat4& model) const {
+	glm::vec3 center = glm::vec3(model * glm::vec4(m_boundsCenter, 1));
+	return view.sphereVisible(center, m_boundsRadius * maxScale(model));
 }
 
-void Mesh3D::render(ShaderProgram& program) const {
-	glBindVertexArray(m_vao);
+void Mesh3D::renderInstanced(ShaderProgram& program, size_t lod, const std::vector<InstanceData>& instances) const {
+	InstanceBuffer::instance().upload(instances);
+	bind(program);
+	program.setUniform(m_instancedUniform, true);
+	const LodRange& range = m_lods[lod];
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, m_indexType,
+		reinterpret_cast<const void*>(range.offset), static_cast<GLsizei>(instances.size()), m_baseVertex);
+	program.setUniform(m_instancedUniform, false);
+}
+
+void Mesh3D::renderInstanced(ShaderProgram& program, const RenderView& view, size_t lod,
+	const std::vector<InstanceData>& instances) const {
+	if (lod != 0 || m_meshlets.size() <= 1) {
+		renderInstanced(program, lod, instances);
+		view.stats.trianglesSubmitted += triangleCount(lod) * instances.size();
+		view.stats.drawCalls++;
+		return;
+	}
+
+	m_instanceModels.clear();
+	for (auto& instance : instances) {
+		m_instanceModels.push_back(instance.model);
+	}
+	cullMeshlets(view, m_instanceModels);
+	if (m_drawCounts.empty()) {
+		return;
+	}
+
+	InstanceBuffer::instance().upload(instances);
+	bind(program);
+	program.setUniform(m_instancedUniform, true);
+	// There is no instanced multi-draw without indirect draws, so each range of meshlets is a draw.
+	for (size_t i = 0; i < m_drawCounts.size(); i++) {
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_drawCounts[i], m_indexType, m_drawOffsets[i],
+			static_cast<GLsizei>(instances.size()), m_baseVertex);
+	}
+	program.setUniform(m_instancedUniform, false);
+	view.stats.drawCalls += m_drawCounts.size();
+}
+
+void Mesh3D::setNodeCount(uint32_t count) {
+	m_nodeCount = count;
+}
+
+bool Mesh3D::shared() const {
+	return m_nodeCount > 1;
+}
+
+DrawElementsIndirectCommand Mesh3D::indirectCommand(size_t lod) const {
+	const LodRange& range = m_lods[lod];
+	size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	return DrawElementsIndirectCommand{ range.indexCount, 1, static_cast<uint32_t>(range.offset / indexSize),
+		m_baseVertex, 0 };
+}
+
+uint32_t Mesh3D::vertexArray() const {
+	return m_vao;
+}
+
+uint32_t Mesh3D::indirectVertexArray() const {
+	return GeometryArena::instance().indirectVertexArray(m_format);
+}
+
+uint32_t Mesh3D::indexType() const {
+	return m_indexType;
+}
+
+const std::vector<Texture>& Mesh3D::getTextures() const {
+	return m_textures;
+}
+
+const PositionQuantization& Mesh3D::quantization() const {
+	return m_quantization;
+}
+
+void Mesh3D::setOccluder(std::shared_ptr<const OccluderMesh> occluder) {
+	m_occluder = std::move(occluder);
+}
+
+const std::shared_ptr<const OccluderMesh>& Mesh3D::occluder() const {
+	return m_occluder;
+}
+
+float Mesh3D::maxScale(const glm::mat4& model) {
+	return std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+		glm::length(glm::vec3(model[2])) });
+}
+
+size_t Mesh3D::selectLod(const RenderView& view, const glm::mat4& model) const {
+	if (m_lods.size() == 1) {
+		return 0;
+	}
+
+	// Errors are measured in local space; scale them to world space by the model matrix's largest
+	// axis scale, which overestimates them under non-uniform scaling.
+	float scale = maxScale(model);
+	glm::vec3 center = glm::vec3(model * glm::vec4(m_boundsCenter, 1));
+	// Take the distance to the nearest point of the bounding sphere, so that the error is never
+	// underestimated for any part of the mesh. Inside the sphere, always draw the full mesh.
+	float distance = glm::length(center - view.cameraPosition) - m_boundsRadius * scale;
+	if (distance <= 0) {
+		return 0;
+	}
+
+	// An error of e world units at distance d covers e / d * pixelsPerUnit pixels.
+	float maxError = view.lodErrorPixels * distance / (view.pixelsPerUnit * scale);
+	size_t selected = 0;
+	for (size_t i = 1; i < m_lods.size() && m_lods[i].error <= maxError; i++) {
+		selected = i;
+	}
+	return selected;
+}
+
+const BoundingBox& Mesh3D::bounds() const {
+	return m_bounds;
+}
+
+size_t Mesh3D::lodCount() const {
+	return m_lods.size();
+}
+
+uint32_t Mesh3D::triangleCount(size_t lod) const {
+	return m_lods[lod].indexCount / 3;
+}
+
+void Mesh3D::resolveUniforms(ShaderProgram& program) const {
+	// Sampler locations only need to be looked up by name the first time we render with a program.
+	if (m_uniformProgram != program.getId()) {
+		m_samplerUniforms.clear();
+		for (auto& texture : m_textures) {
+			m_samplerUniforms.push_back(program.getUniform(texture.samplerName));
+		}
+		m_positionScaleUniform = program.getUniform("positionScale");
+		m_positionOffsetUniform = program.getUniform("positionOffset");
+		m_instancedUniform = program.getUniform("instanced");
+		m_uniformProgram = program.getId();
+	}
+}
+
+void Mesh3D::bind(ShaderProgram& program) const {
+	resolveUniforms(program);
+	program.setUniform(m_positionScaleUniform, m_quantization.scale);
+	program.setUniform(m_positionOffsetUniform, m_quantization.offset);
+	// Meshes are left bound after drawing, so consecutive meshes that share the vertex array and
+	// textures skip binding them again.
+	GLStateCache::instance().bindVertexArray(m_vao);
+	bindTextures(program);
+}
+
+void Mesh3D::bindTextures(ShaderProgram& program) const {
+	resolveUniforms(program);
+	auto& state = GLStateCache::instance();
 	for (auto i = 0; i < m_textures.size(); i++) {
-		program.setUniform(m_textures[i].samplerName, i);
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
+		state.setSampler(program, m_samplerUniforms[i], i);
+		state.bindTexture(i, m_textures[i].textureId);
 	}
+}
 
+void Mesh3D::renderLod(ShaderProgram& program, size_t lod) const {
+	bind(program);
 	// Draw the vertex array, using its "element buffer" to identify the faces.
-	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
-	// Deactivate the mesh's vertex array and texture.
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	const LodRange& range = m_lods[lod];
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, m_indexType, reinterpret_cast<const void*>(range.offset),
+		m_baseVertex);
+}
+
+void Mesh3D::renderMeshlets(ShaderProgram& program, const RenderView& view, const glm::mat4& model) const {
+	cullMeshlets(view, std::span<const glm::mat4>(&model, 1));
+	if (m_drawCounts.empty()) {
+		return;
+	}
+
+	bind(program);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), m_indexType, m_drawOffsets.data(),
+		static_cast<GLsizei>(m_drawCounts.size()), m_drawBaseVertices.data());
+	view.stats.drawCalls++;
+}
+
+void Mesh3D::cullMeshlets(const RenderView& view, std::span<const glm::mat4> models) const {
+	struct Placement {
+		glm::mat4 model;
+		glm::mat3 linear;
+		float scale;
+		bool cullBackfaces;
+	};
+	std::vector<Placement> placements;
+	for (auto& model : models) {
+		float scale = maxScale(model);
+		// Normal cones can only be transformed like directions if the model matrix preserves angles
+		// and winding: a uniform scale, and no mirroring.
+		glm::mat3 linear(model);
+		bool cullBackfaces = view.cullBackfaces
+			&& std::abs(glm::length(linear[0]) - glm::length(linear[1])) <= 1e-3f * scale
+			&& std::abs(glm::length(linear[0]) - glm::length(linear[2])) <= 1e-3f * scale
+			&& glm::determinant(linear) > 0;
+		placements.push_back(Placement{ model, linear, scale, cullBackfaces });
+	}
+
+	// Collect the index ranges of the visible meshlets. Meshlets are stored in order, so adjacent
+	// visible ones merge into a single range.
+	size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	m_drawCounts.clear();
+	m_drawOffsets.clear();
+	m_drawBaseVertices.clear();
+	size_t nextOffset = SIZE_MAX;
+	for (auto& meshlet : m_meshlets) {
+		view.stats.meshletsTested++;
+		bool visible = std::any_of(placements.begin(), placements.end(), [&](const Placement& p) {
+			glm::vec3 center = glm::vec3(p.model * glm::vec4(meshlet.center, 1));
+			float radius = meshlet.radius * p.scale;
+			return view.sphereVisible(center, radius)
+				&& !(p.cullBackfaces && meshletBackfacing(center, radius, glm::normalize(p.linear * meshlet.coneAxis),
+					meshlet.coneCutoff, view.cameraPosition));
+		});
+		if (!visible) {
+			view.stats.meshletsCulled++;
+			continue;
+		}
+
+		size_t offset = m_geometry->indexOffset + meshlet.firstIndex * indexSize;
+		if (offset == nextOffset) {
+			m_drawCounts.back() += meshlet.indexCount;
+		}
+		else {
+			m_drawCounts.push_back(meshlet.indexCount);
+			m_drawOffsets.push_back(reinterpret_cast<const void*>(offset));
+			m_drawBaseVertices.push_back(m_baseVertex);
+		}
+		nextOffset = offset + meshlet.indexCount * indexSize;
+		view.stats.trianglesSubmitted += meshlet.indexCount / 3 * models.size();
+	}
 }
 
 
@@ -0,0 +1,141 @@
+#include "MeshOptimizer.h"
+#include <deque>
+
+const size_t VERTICES_PER_TRIANGLE = 3;
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& faces, size_t vertexCount) {
+	// The time each vertex entered the cache. A vertex is still cached if fewer than
+	// VERTEX_CACHE_SIZE misses have happened since then.
+	std::vector<size_t> cachedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0;
+	size_t usedCount = 0;
+
+	for (auto v : faces) {
+		if (!used[v]) {
+			used[v] = true;
+			usedCount++;
+		}
+		if (cachedAt[v] == 0 || misses - cachedAt[v] >= VERTEX_CACHE_SIZE) {
+			misses++;
+			cachedAt[v] = misses;
+		}
+	}
+
+	size_t triangleCount = faces.size() / VERTICES_PER_TRIANGLE;
+	return VertexCacheStats{
+		triangleCount == 0 ? 0.0f : float(misses) / triangleCount,
+		usedCount == 0 ? 0.0f : float(misses) / usedCount
+	};
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& faces, size_t vertexCount) {
+	size_t triangleCount = faces.size() / VERTICES_PER_TRIANGLE;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Build the vertex->triangle adjacency as one flat list, indexed by per-vertex offsets.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (auto v : faces) {
+		liveTriangles[v]++;
+	}
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			adjacency[fill[faces[t * VERTICES_PER_TRIANGLE + c]]++] = static_cast<uint32_t>(t);
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(faces.size());
+	std::vector<bool> emitted(triangleCount, false);
+	// The time each vertex last entered the simulated cache, in units of cache misses.
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t time = VERTEX_CACHE_SIZE + 1;
+	// Recently used vertices, to restart from when we reach a dead end.
+	std::vector<uint32_t> deadEnds;
+	// The next vertex to try when there are no better restart candidates.
+	size_t cursor = 0;
+
+	int64_t fanning = faces[0];
+	std::vector<uint32_t> candidates;
+	while (fanning >= 0) {
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for (size_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+			auto t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+				auto v = faces[t * VERTICES_PER_TRIANGLE + c];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > VERTEX_CACHE_SIZE) {
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// Pick the next fanning vertex: the candidate that will still be in the cache after its
+		// remaining triangles are emitted, and has been in the cache the longest.
+		fanning = -1;
+		size_t bestPriority = 0;
+		for (auto v : candidates) {
+			if (liveTriangles[v] == 0) {
+				continue;
+			}
+			size_t priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= VERTEX_CACHE_SIZE) {
+				priority = time - cacheTime[v];
+			}
+			if (fanning < 0 || priority > bestPriority) {
+				fanning = v;
+				bestPriority = priority;
+			}
+		}
+
+		// At a dead end, restart from a recently used vertex, or else the next unfinished one.
+		while (fanning < 0 && !deadEnds.empty()) {
+			auto v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0) {
+				fanning = v;
+			}
+		}
+		while (fanning < 0 && cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0) {
+				fanning = cursor;
+			}
+			cursor++;
+		}
+	}
+
+	faces = std::move(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) {
+	const uint32_t UNASSIGNED = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), UNASSIGNED);
+	std::vector<Vertex3D> reordered;
+	reordered.reserve(vertices.size());
+
+	for (auto& v : faces) {
+		if (remap[v] == UNASSIGNED) {
+			remap[v] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[v]);
+		}
+		v = remap[v];
+	}
+
+	vertices = std::move(reordered);
+}
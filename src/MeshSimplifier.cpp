@@ -0,0 +1,250 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <queue>
+#include <string>
+#include <unordered_map>
+
+const size_t VERTICES_PER_TRIANGLE = 3;
+
+/**
+ * @brief A symmetric 4x4 matrix measuring the sum of squared distances from a point to a set of
+ * planes. Only the upper triangle is stored.
+ */
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	static Quadric plane(double a, double b, double c, double d) {
+		return Quadric{ a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+	}
+
+	Quadric& operator+=(const Quadric& o) {
+		a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+		bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+		return *this;
+	}
+
+	double evaluate(const Vertex3D& v) const {
+		double x = v.x, y = v.y, z = v.z;
+		return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z
+			+ d2;
+	}
+};
+
+struct Collapse {
+	double cost;
+	uint32_t from;
+	uint32_t to;
+	// The versions of the two vertices when this collapse was evaluated; if either has changed
+	// since, the cost is stale.
+	uint32_t fromVersion;
+	uint32_t toVersion;
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+glm::vec3 positionOf(const Vertex3D& v) {
+	return glm::vec3(v.x, v.y, v.z);
+}
+
+glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+MeshLod simplifyMesh(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces,
+	size_t targetTriangleCount) {
+	std::vector<uint32_t> triangles = faces;
+	size_t triangleCount = triangles.size() / VERTICES_PER_TRIANGLE;
+	if (triangleCount <= targetTriangleCount) {
+		return MeshLod{ triangles, 0 };
+	}
+
+	// Vertices that share a position are copies split along a seam. Give each distinct position an
+	// id, so that boundaries are found on the surface rather than on the vertex list.
+	std::unordered_map<std::string, uint32_t> positionIds;
+	std::vector<uint32_t> positionId(vertices.size());
+	std::vector<uint32_t> copiesOfPosition;
+	for (size_t v = 0; v < vertices.size(); v++) {
+		std::string key(reinterpret_cast<const char*>(&vertices[v].x), 3 * sizeof(float));
+		auto [entry, inserted] = positionIds.emplace(key, static_cast<uint32_t>(positionIds.size()));
+		positionId[v] = entry->second;
+		if (inserted) {
+			copiesOfPosition.push_back(0);
+		}
+		copiesOfPosition[entry->second]++;
+	}
+
+	// Lock seam vertices, and vertices on any edge that only one triangle uses.
+	std::vector<bool> locked(vertices.size(), false);
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	auto edgeKey = [&](uint32_t a, uint32_t b) {
+		uint64_t pa = positionId[a], pb = positionId[b];
+		return pa < pb ? (pa << 32) | pb : (pb << 32) | pa;
+	};
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			edgeUses[edgeKey(triangles[t * 3 + c], triangles[t * 3 + (c + 1) % 3])]++;
+		}
+	}
+	for (size_t v = 0; v < vertices.size(); v++) {
+		locked[v] = copiesOfPosition[positionId[v]] > 1;
+	}
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			uint32_t a = triangles[t * 3 + c], b = triangles[t * 3 + (c + 1) % 3];
+			if (edgeUses[edgeKey(a, b)] == 1) {
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+
+	// Accumulate the quadric of every triangle's plane into its vertices, and build the
+	// vertex->triangle adjacency.
+	std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+	std::vector<std::vector<uint32_t>> adjacent(vertices.size());
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t* tri = &triangles[t * 3];
+		glm::vec3 normal = triangleNormal(positionOf(vertices[tri[0]]), positionOf(vertices[tri[1]]),
+			positionOf(vertices[tri[2]]));
+		float length = glm::length(normal);
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			adjacent[tri[c]].push_back(static_cast<uint32_t>(t));
+		}
+		if (length <= 0) {
+			continue;
+		}
+		normal /= length;
+		Quadric q = Quadric::plane(normal.x, normal.y, normal.z, -glm::dot(normal, positionOf(vertices[tri[0]])));
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			quadrics[tri[c]] += q;
+		}
+	}
+
+	std::vector<uint32_t> version(vertices.size(), 0);
+	std::vector<bool> alive(triangleCount, true);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+
+	auto pushCollapse = [&](uint32_t from, uint32_t to) {
+		if (locked[from]) {
+			return;
+		}
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		collapses.push(Collapse{ std::max(0.0, q.evaluate(vertices[to])), from, to, version[from], version[to] });
+	};
+	auto pushNeighborhood = [&](uint32_t v) {
+		for (auto t : adjacent[v]) {
+			for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+				uint32_t n = triangles[t * 3 + c];
+				if (n != v) {
+					pushCollapse(v, n);
+					pushCollapse(n, v);
+				}
+			}
+		}
+	};
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			pushCollapse(triangles[t * 3 + c], triangles[t * 3 + (c + 1) % 3]);
+			pushCollapse(triangles[t * 3 + (c + 1) % 3], triangles[t * 3 + c]);
+		}
+	}
+
+	double maxCost = 0;
+	while (triangleCount > targetTriangleCount && !collapses.empty()) {
+		Collapse collapse = collapses.top();
+		collapses.pop();
+		uint32_t from = collapse.from, to = collapse.to;
+		if (collapse.fromVersion != version[from] || collapse.toVersion != version[to]) {
+			continue;
+		}
+
+		// Earlier collapses may have removed triangles that these vertices' adjacency still lists.
+		std::erase_if(adjacent[from], [&](uint32_t t) { return !alive[t]; });
+		std::erase_if(adjacent[to], [&](uint32_t t) { return !alive[t]; });
+
+		// The collapse removes the triangles that share the edge. If there are none, an earlier
+		// collapse has separated the two vertices. If the vertices have more neighbors in common
+		// than those triangles account for, the collapse would pinch the surface into a non-manifold.
+		size_t sharedTriangles = 0;
+		std::vector<uint32_t> fromNeighbors, toNeighbors;
+		for (auto t : adjacent[from]) {
+			uint32_t* tri = &triangles[t * 3];
+			sharedTriangles += tri[0] == to || tri[1] == to || tri[2] == to;
+			fromNeighbors.insert(fromNeighbors.end(), tri, tri + VERTICES_PER_TRIANGLE);
+		}
+		for (auto t : adjacent[to]) {
+			toNeighbors.insert(toNeighbors.end(), &triangles[t * 3], &triangles[t * 3] + VERTICES_PER_TRIANGLE);
+		}
+		std::sort(fromNeighbors.begin(), fromNeighbors.end());
+		fromNeighbors.erase(std::unique(fromNeighbors.begin(), fromNeighbors.end()), fromNeighbors.end());
+		std::sort(toNeighbors.begin(), toNeighbors.end());
+		toNeighbors.erase(std::unique(toNeighbors.begin(), toNeighbors.end()), toNeighbors.end());
+		std::vector<uint32_t> commonNeighbors;
+		std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(), toNeighbors.begin(), toNeighbors.end(),
+			std::back_inserter(commonNeighbors));
+		// The common neighbors include the two vertices themselves.
+		if (sharedTriangles == 0 || commonNeighbors.size() - 2 > sharedTriangles) {
+			continue;
+		}
+
+		// Reject collapses that would flip any triangle that survives them.
+		bool flips = false;
+		for (auto t : adjacent[from]) {
+			uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to) {
+				continue;
+			}
+			glm::vec3 before[3], after[3];
+			for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+				before[c] = positionOf(vertices[tri[c]]);
+				after[c] = positionOf(vertices[tri[c] == from ? to : tri[c]]);
+			}
+			if (glm::dot(triangleNormal(before[0], before[1], before[2]), triangleNormal(after[0], after[1], after[2])) <= 0) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		// Move every triangle of `from` onto `to`. Those that already used `to` become degenerate.
+		for (auto t : adjacent[from]) {
+			uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to) {
+				alive[t] = false;
+				triangleCount--;
+				continue;
+			}
+			for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+				if (tri[c] == from) {
+					tri[c] = to;
+				}
+			}
+			adjacent[to].push_back(t);
+		}
+		adjacent[from].clear();
+		std::erase_if(adjacent[to], [&](uint32_t t) { return !alive[t]; });
+
+		maxCost = std::max(maxCost, collapse.cost);
+		quadrics[to] += quadrics[from];
+		// Every edge touching `to` has a new cost; bumping its version invalidates their old entries.
+		version[from]++;
+		version[to]++;
+		pushNeighborhood(to);
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * VERTICES_PER_TRIANGLE);
+	for (size_t t = 0; t < alive.size(); t++) {
+		if (alive[t]) {
+			result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + VERTICES_PER_TRIANGLE);
+		}
+	}
+	return MeshLod{ std::move(result), static_cast<float>(std::sqrt(maxCost)) };
+}
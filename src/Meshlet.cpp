@@ -0,0 +1,135 @@
+#include "Meshlet.h"
+#include "Mesh3D.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+const size_t VERTICES_PER_TRIANGLE = 3;
+// If any triangle's normal is within about 84 degrees of perpendicular to the cone axis, the cone
+// is too wide to ever be backfacing as a whole.
+const float MESHLET_MIN_CONE_DOT = 0.1f;
+
+glm::vec3 facePosition(const std::vector<Vertex3D>& vertices, uint32_t index) {
+	return glm::vec3(vertices[index].x, vertices[index].y, vertices[index].z);
+}
+
+/**
+ * @brief Computes a meshlet's bounding sphere and normal cone from its triangles.
+ */
+void computeMeshletBounds(Meshlet& meshlet, const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces) {
+	auto first = faces.begin() + meshlet.firstIndex;
+	auto last = first + meshlet.indexCount;
+
+	glm::vec3 minimum = facePosition(vertices, *first), maximum = minimum;
+	for (auto i = first; i != last; i++) {
+		minimum = glm::min(minimum, facePosition(vertices, *i));
+		maximum = glm::max(maximum, facePosition(vertices, *i));
+	}
+	meshlet.center = (minimum + maximum) * 0.5f;
+	meshlet.radius = 0;
+	for (auto i = first; i != last; i++) {
+		meshlet.radius = std::max(meshlet.radius, glm::length(facePosition(vertices, *i) - meshlet.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	glm::vec3 axis(0);
+	for (auto i = first; i != last; i += VERTICES_PER_TRIANGLE) {
+		glm::vec3 p0 = facePosition(vertices, i[0]);
+		glm::vec3 normal = glm::cross(facePosition(vertices, i[1]) - p0, facePosition(vertices, i[2]) - p0);
+		float area = glm::length(normal);
+		if (area > 0) {
+			normals.push_back(normal / area);
+			axis += normals.back();
+		}
+	}
+
+	meshlet.coneAxis = glm::vec3(0, 0, 1);
+	meshlet.coneCutoff = 1;
+	if (normals.empty() || glm::length(axis) <= 0) {
+		return;
+	}
+	axis = glm::normalize(axis);
+	float minDot = 1;
+	for (auto& normal : normals) {
+		minDot = std::min(minDot, glm::dot(axis, normal));
+	}
+	meshlet.coneAxis = axis;
+	if (minDot > MESHLET_MIN_CONE_DOT) {
+		meshlet.coneCutoff = std::sqrt(1 - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) {
+	size_t triangleCount = faces.size() / VERTICES_PER_TRIANGLE;
+
+	// Which triangles use each vertex.
+	std::vector<std::vector<uint32_t>> trianglesOfVertex(vertices.size());
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+			trianglesOfVertex[faces[t * 3 + c]].push_back(static_cast<uint32_t>(t));
+		}
+	}
+
+	std::vector<bool> assigned(triangleCount, false);
+	std::vector<uint32_t> reordered;
+	reordered.reserve(faces.size());
+	std::vector<Meshlet> meshlets;
+
+	size_t nextSeed = 0;
+	while (true) {
+		// Seed each meshlet with the first unassigned triangle. The faces are already in vertex cache
+		// order, so consecutive seeds tend to be near each other.
+		while (nextSeed < triangleCount && assigned[nextSeed]) {
+			nextSeed++;
+		}
+		if (nextSeed == triangleCount) {
+			break;
+		}
+
+		// Grow breadth-first across triangles that share a vertex with the meshlet, which keeps it
+		// roughly disc-shaped and so its bounds tight.
+		std::vector<uint32_t> members;
+		std::deque<uint32_t> frontier{ static_cast<uint32_t>(nextSeed) };
+		assigned[nextSeed] = true;
+		while (!frontier.empty() && members.size() < MESHLET_MAX_TRIANGLES) {
+			uint32_t t = frontier.front();
+			frontier.pop_front();
+			members.push_back(t);
+			for (size_t c = 0; c < VERTICES_PER_TRIANGLE; c++) {
+				for (auto neighbor : trianglesOfVertex[faces[t * 3 + c]]) {
+					if (!assigned[neighbor]) {
+						assigned[neighbor] = true;
+						frontier.push_back(neighbor);
+					}
+				}
+			}
+		}
+		// Triangles that were reached but didn't fit go back to the pool for a later meshlet.
+		for (auto t : frontier) {
+			assigned[t] = false;
+		}
+
+		std::sort(members.begin(), members.end());
+		Meshlet meshlet{};
+		meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+		meshlet.indexCount = static_cast<uint32_t>(members.size() * VERTICES_PER_TRIANGLE);
+		for (auto t : members) {
+			reordered.insert(reordered.end(), faces.begin() + t * 3, faces.begin() + t * 3 + VERTICES_PER_TRIANGLE);
+		}
+		meshlets.push_back(meshlet);
+	}
+
+	faces = std::move(reordered);
+	for (auto& meshlet : meshlets) {
+		computeMeshletBounds(meshlet, vertices, faces);
+	}
+	return meshlets;
+}
+
+bool meshletBackfacing(const glm::vec3& center, float radius, const glm::vec3& coneAxis, float coneCutoff,
+	const glm::vec3& cameraPosition) {
+	// The camera is behind every triangle if it lies outside the cone (widened by the meshlet's
+	// radius) that opens backward from the meshlet along its axis.
+	glm::vec3 toCenter = center - cameraPosition;
+	return glm::dot(toCenter, coneAxis) >= coneCutoff * glm::length(toCenter) + radius;
+}
@@ -1,17 +1,59 @@
 #include "Object3D.h"
+#include "Scheduler.h"
 #include "ShaderProgram.h"
 #include <glm/ext.hpp>
+#include <cassert>
+#include <cmath>
+
+uint64_t Object3D::s_topologyVersion = 0;
+
+uint64_t Object3D::topologyVersion() {
+	return s_topologyVersion;
+}
+
+void Object3D::hierarchyChanged() {
+	// The version isn't atomic: hierarchies are only edited and rendered on the GL thread.
+	assert(onGLThread());
+	s_topologyVersion++;
+}
+
+glm::mat3 Object3D::normalMatrix(const glm::mat4& model) {
+	return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+glm::quat Object3D::eulerRotation(const glm::vec3& orientation) {
+	return glm::angleAxis(orientation.z, glm::vec3(0, 0, 1)) * glm::angleAxis(orientation.x, glm::vec3(1, 0, 0))
+		* glm::angleAxis(orientation.y, glm::vec3(0, 1, 0));
+}
+
+/**
+ * @brief The Euler angles of a rotation; the inverse of Object3D::eulerRotation, with X in
+ * [-pi/2, pi/2].
+ */
+static glm::vec3 quatToEuler(const glm::quat& rotation) {
+	// The third row of Rz * Rx * Ry is (-cos x sin y, sin x, cos x cos y), and its second column
+	// is (-sin z cos x, cos z cos x, sin x).
+	glm::mat3 m = glm::mat3_cast(rotation);
+	float cosX = std::sqrt(m[1][0] * m[1][0] + m[1][1] * m[1][1]);
+	float x = std::atan2(m[1][2], cosX);
+	if (cosX > 1e-6f) {
+		return glm::vec3(x, std::atan2(-m[0][2], m[2][2]), std::atan2(-m[1][0], m[1][1]));
+	}
+	// Gimbal lock: Y and Z rotate about the same axis, so put all of it in Z.
+	return glm::vec3(x, 0, std::atan2(m[0][1], m[0][0]));
+}
 
 glm::mat4 Object3D::buildModelMatrix() const {
-	auto m = glm::translate(glm::mat4(1), m_position);
-	m = glm::translate(m, m_center * m_scale);
-	m = glm::rotate(m, m_orientation[2], glm::vec3(0, 0, 1));
-	m = glm::rotate(m, m_orientation[0], glm::vec3(1, 0, 0));
-	m = glm::rotate(m, m_orientation[1], glm::vec3(0, 1, 0));
-	m = glm::scale(m, m_scale);
-	m = glm::translate(m, -m_center);
-	m = m * m_baseTransform;
-	return m;
+	// translate(position) * translate(center * scale) * rotation * scale * translate(-center),
+	// composed directly into one affine matrix: its linear part is the rotation with its columns
+	// scaled, and its translation is wherever that takes the point -center to, plus the offsets.
+	glm::mat3 linear = glm::mat3_cast(m_rotation);
+	linear[0] = linear[0] * m_scale.x;
+	linear[1] = linear[1] * m_scale.y;
+	linear[2] = linear[2] * m_scale.z;
+	glm::mat4 m(linear);
+	m[3] = glm::vec4(m_position + m_center * m_scale - linear * m_center, 1);
+	return m * m_baseTransform;
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes)
@@ -19,8 +61,16 @@ Object3D::Object3D(std::vector<Mesh3D>&& meshes)
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform)
-	: m_meshes(meshes), m_position(), m_orientation(), m_scale(1.0),
-	m_center(), m_baseTransform(baseTransform), m_material(0.1, 1.0, 0.3, 4)
+	: Object3D(std::vector<std::shared_ptr<Mesh3D>>(), baseTransform) {
+	for (auto& mesh : meshes) {
+		m_meshes.push_back(std::make_shared<Mesh3D>(std::move(mesh)));
+	}
+}
+
+Object3D::Object3D(std::vector<std::shared_ptr<Mesh3D>>&& meshes, const glm::mat4& baseTransform)
+	: m_meshes(std::move(meshes)), m_position(), m_rotation(1, 0, 0, 0), m_orientation(), m_orientationDirty(false),
+	m_scale(1.0), m_center(), m_baseTransform(baseTransform), m_material(0.1, 1.0, 0.3, 4), m_uniformProgram(0),
+	m_localMatrix(1), m_worldMatrix(1), m_normalMatrix(1), m_localDirty(true), m_worldDirty(true)
 {
 }
 
@@ -29,9 +79,17 @@ const glm::vec3& Object3D::getPosition() const {
 }
 
 const glm::vec3& Object3D::getOrientation() const {
+	if (m_orientationDirty) {
+		m_orientation = quatToEuler(m_rotation);
+		m_orientationDirty = false;
+	}
 	return m_orientation;
 }
 
+const glm::quat& Object3D::getRotation() const {
+	return m_rotation;
+}
+
 const glm::vec3& Object3D::getScale() const {
 	return m_scale;
 }
@@ -51,6 +109,18 @@ const glm::vec4& Object3D::getMaterial() const {
 	return m_material;
 }
 
+const std::vector<std::shared_ptr<Mesh3D>>& Object3D::getMeshes() const {
+	return m_meshes;
+}
+
+const glm::mat4& Object3D::getLocalMatrix() const {
+	if (m_localDirty) {
+		m_localMatrix = buildModelMatrix();
+		m_localDirty = false;
+	}
+	return m_localMatrix;
+}
+
 size_t Object3D::numberOfChildren() const {
 	return m_children.size();
 }
@@ -65,14 +135,25 @@ Object3D& Object3D::getChild(size_t index) {
 
 void Object3D::setPosition(const glm::vec3& position) {
 	m_position = position;
+	m_localDirty = true;
 }
 
 void Object3D::setOrientation(const glm::vec3& orientation) {
 	m_orientation = orientation;
+	m_orientationDirty = false;
+	m_rotation = eulerRotation(orientation);
+	m_localDirty = true;
+}
+
+void Object3D::setRotation(const glm::quat& rotation) {
+	m_rotation = glm::normalize(rotation);
+	m_orientationDirty = true;
+	m_localDirty = true;
 }
 
 void Object3D::setScale(const glm::vec3& scale) {
 	m_scale = scale;
+	m_localDirty = true;
 }
 
 /**
@@ -82,6 +163,7 @@ void Object3D::setScale(const glm::vec3& scale) {
 void Object3D::setCenter(const glm::vec3& center)
 {
 	m_center = center;
+	m_localDirty = true;
 }
 
 void Object3D::setName(const std::string& name) {
@@ -94,38 +176,103 @@ void Object3D::setMaterial(const glm::vec4& material) {
 
 void Object3D::move(const glm::vec3& offset) {
 	m_position = m_position + offset;
+	m_localDirty = true;
 }
 
 void Object3D::rotate(const glm::vec3& rotation) {
-	m_orientation = m_orientation + rotation;
+	// This adds angles rather than composing rotations.
+	setOrientation(getOrientation() + rotation);
+}
+
+void Object3D::rotate(const glm::quat& rotation) {
+	setRotation(m_rotation * rotation);
 }
 
 void Object3D::grow(const glm::vec3& growth) {
 	m_scale = m_scale * growth;
+	m_localDirty = true;
 }
 
 void Object3D::addChild(Object3D&& child) {
+	// The child's cached world matrix was relative to its old parent, if any.
+	child.m_worldDirty = true;
 	m_children.emplace_back(child);
+	hierarchyChanged();
 }
 
-void Object3D::render(ShaderProgram& shaderProgram) const {
-	renderRecursive(shaderProgram, glm::mat4(1));
+void Object3D::render(ShaderProgram& shaderProgram, const glm::mat4& viewProjection) const {
+	renderPass(shaderProgram, viewProjection, nullptr, nullptr);
+}
+
+void Object3D::render(ShaderProgram& shaderProgram, const RenderView& view) const {
+	renderPass(shaderProgram, view.viewProjection, &view, nullptr);
+}
+
+void Object3D::render(ShaderProgram& shaderProgram, const RenderView& view, IndirectRenderer& indirect) const {
+	renderPass(shaderProgram, view.viewProjection, &view, &indirect);
+}
+
+void Object3D::renderPass(ShaderProgram& shaderProgram, const glm::mat4& viewProjection, const RenderView* view,
+	IndirectRenderer* indirect) const {
+	// Look up the transform uniforms once per program, and hand the handles down the hierarchy.
+	if (m_uniformProgram != shaderProgram.getId()) {
+		m_normalMatrixUniform = shaderProgram.getUniform("normalMatrix");
+		m_modelViewProjectionUniform = shaderProgram.getUniform("modelViewProjection");
+		m_uniformProgram = shaderProgram.getId();
+	}
+	InstanceBatcher instances;
+	renderRecursive(shaderProgram, RenderPass{ m_normalMatrixUniform, m_modelViewProjectionUniform,
+		viewProjection, view, instances, indirect }, glm::mat4(1), false);
+	instances.flush(shaderProgram, view);
 }
 
 /**
  * @brief Renders the object and its children, recursively.
  * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
+ * @param parentChanged whether parentMatrix differs from the last time this object was rendered.
  */
-void Object3D::renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
+void Object3D::renderRecursive(ShaderProgram& shaderProgram, const RenderPass& pass,
+	const glm::mat4& parentMatrix, bool parentChanged) const {
 	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
-	glm::mat4 trueModel = parentMatrix * buildModelMatrix();
-	shaderProgram.setUniform("model", trueModel);
-	// Render each mesh in the object.
+	// Only recompute the parts that have changed since the last render.
+	bool changed = parentChanged || m_worldDirty || m_localDirty;
+	if (changed) {
+		m_worldMatrix = parentMatrix * getLocalMatrix();
+		m_normalMatrix = normalMatrix(m_worldMatrix);
+		m_worldDirty = false;
+	}
+	if (!pass.indirect) {
+		shaderProgram.setUniform(pass.normalMatrixUniform, m_normalMatrix);
+		shaderProgram.setUniform(pass.modelViewProjectionUniform, pass.viewProjection * m_worldMatrix);
+	}
+	// Render each mesh in the object. A mesh that other objects draw too is batched with them.
 	for (auto& mesh : m_meshes) {
-		mesh.render(shaderProgram);
+		if (pass.indirect) {
+			if (!pass.view) {
+				pass.indirect->add(*mesh, 0, m_worldMatrix, m_material);
+			}
+			else if (mesh->inView(*pass.view, m_worldMatrix)) {
+				pass.indirect->add(*mesh, mesh->selectLod(*pass.view, m_worldMatrix), m_worldMatrix, m_material);
+			}
+		}
+		else if (mesh->shared()) {
+			if (!pass.view) {
+				pass.instances.add(*mesh, 0, m_worldMatrix, m_material);
+			}
+			else if (mesh->inView(*pass.view, m_worldMatrix)) {
+				pass.instances.add(*mesh, mesh->selectLod(*pass.view, m_worldMatrix), m_worldMatrix,
+					m_material);
+			}
+		}
+		else if (pass.view) {
+			mesh->render(shaderProgram, *pass.view, m_worldMatrix);
+		}
+		else {
+			mesh->render(shaderProgram);
+		}
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(shaderProgram, trueModel);
+		child.renderRecursive(shaderProgram, pass, m_worldMatrix, changed);
 	}
 }
@@ -0,0 +1,339 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
+// How much nearer than the occluders a box must be to count as visible, to absorb rounding in
+// the interpolated depths.
+const float OCCLUSION_DEPTH_BIAS = 1e-6f;
+
+OcclusionBuffer::OcclusionBuffer(size_t width, size_t height)
+	: m_width((width + 3) & ~size_t(3)), m_height(height), m_depth(m_width * height, 1.0f),
+	m_viewProjection(1), m_pending(false), m_stopping(false) {
+	m_worker = std::thread(&OcclusionBuffer::work, this);
+}
+
+OcclusionBuffer::~OcclusionBuffer() {
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_changed.notify_all();
+	m_worker.join();
+}
+
+void OcclusionBuffer::work() {
+	std::unique_lock lock(m_mutex);
+	while (true) {
+		m_changed.wait(lock, [&] { return m_pending || m_stopping; });
+		if (m_stopping) {
+			return;
+		}
+		// The caller waits for m_pending to clear before touching the buffer or the pending
+		// occluders, so they can be used without the lock.
+		lock.unlock();
+		rasterizeNow(m_pendingViewProjection, m_pendingOccluders);
+		m_pendingOccluders.clear();
+		lock.lock();
+		m_pending = false;
+		m_changed.notify_all();
+	}
+}
+
+void OcclusionBuffer::rasterizeAsync(const glm::mat4& viewProjection, std::vector<OccluderDraw>&& occluders) {
+	wait();
+	{
+		std::lock_guard lock(m_mutex);
+		m_pendingViewProjection = viewProjection;
+		m_pendingOccluders = std::move(occluders);
+		m_pending = true;
+	}
+	m_changed.notify_all();
+}
+
+void OcclusionBuffer::wait() const {
+	std::unique_lock lock(m_mutex);
+	m_changed.wait(lock, [&] { return !m_pending; });
+}
+
+/**
+ * @brief Maps a clip-space position to the buffer's window space: x and y in pixels, z in [0, 1].
+ */
+static glm::vec3 toWindow(const glm::vec4& clip, size_t width, size_t height) {
+	return glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height,
+		clip.z / clip.w * 0.5f + 0.5f);
+}
+
+/**
+ * @brief Whether a clip-space position is behind the near plane.
+ */
+static bool behindNearPlane(const glm::vec4& clip) {
+	return clip.w <= 0 || clip.z < -clip.w;
+}
+
+void OcclusionBuffer::rasterize(const glm::mat4& viewProjection, const std::vector<OccluderDraw>& occluders) {
+	wait();
+	rasterizeNow(viewProjection, occluders);
+}
+
+void OcclusionBuffer::rasterizeNow(const glm::mat4& viewProjection, const std::vector<OccluderDraw>& occluders) {
+	m_viewProjection = viewProjection;
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+
+	std::vector<glm::vec4> clip;
+	for (auto& occluder : occluders) {
+		glm::mat4 modelViewProjection = viewProjection * occluder.model;
+		clip.clear();
+		for (auto& p : occluder.mesh->positions) {
+			clip.push_back(modelViewProjection * glm::vec4(p, 1));
+		}
+		auto& indices = occluder.mesh->indices;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			rasterizeTriangle(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]);
+		}
+	}
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	// Clipping against the near plane would add vertices; skipping the triangle only makes the
+	// occluders smaller, which never hides anything that is visible.
+	if (behindNearPlane(a) || behindNearPlane(b) || behindNearPlane(c)) {
+		return;
+	}
+	glm::vec3 v0 = toWindow(a, m_width, m_height);
+	glm::vec3 v1 = toWindow(b, m_width, m_height);
+	glm::vec3 v2 = toWindow(c, m_width, m_height);
+	// Occluders hide things with both of their faces, so orient every triangle counterclockwise.
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (area == 0) {
+		return;
+	}
+	if (area < 0) {
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+	int maxX = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+	int minY = std::max(0, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+	int maxY = std::min(static_cast<int>(m_height) - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+	if (minX > maxX || minY > maxY) {
+		return;
+	}
+
+	// Each edge function is positive on the inside of its edge, and is linear in the pixel
+	// position: e(x, y) = e0 + dx * x + dy * y, sampled at pixel centers. Edge i is opposite
+	// vertex i, so e_i / area is vertex i's barycentric weight.
+	auto edge = [](const glm::vec3& from, const glm::vec3& to) {
+		return glm::vec3(from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x);
+	};
+	glm::vec3 edges[3] = { edge(v1, v2), edge(v2, v0), edge(v0, v1) };
+	// The depth is linear in window space too: z(x, y) = z0 + dzdx * x + dzdy * y.
+	float dzdx = (edges[0].x * v0.z + edges[1].x * v1.z + edges[2].x * v2.z) / area;
+	float dzdy = (edges[0].y * v0.z + edges[1].y * v1.z + edges[2].y * v2.z) / area;
+	float z0 = (edges[0].z * v0.z + edges[1].z * v1.z + edges[2].z * v2.z) / area;
+
+	// Start each row at a multiple of 4, so that 4-pixel groups are aligned within the row.
+	int startX = minX & ~3;
+	for (int y = minY; y <= maxY; y++) {
+		float py = y + 0.5f;
+		float* row = &m_depth[y * m_width];
+#ifdef OCCLUSION_BUFFER_SSE
+		__m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		for (int x = startX; x <= maxX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (auto& e : edges) {
+				__m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e.x), px), _mm_set1_ps(e.y * py + e.z));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(value, _mm_setzero_ps()));
+			}
+			if (_mm_movemask_ps(inside) == 0) {
+				continue;
+			}
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + z0));
+			__m128 stored = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(stored, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+		}
+#else
+		for (int x = minX; x <= maxX; x++) {
+			float px = x + 0.5f;
+			bool inside = true;
+			for (auto& e : edges) {
+				inside = inside && e.x * px + e.y * py + e.z >= 0;
+			}
+			if (inside) {
+				row[x] = std::min(row[x], dzdx * px + dzdy * py + z0);
+			}
+		}
+#endif
+	}
+}
+
+bool OcclusionBuffer::boxVisible(const BoundingBox& box) const {
+	wait();
+	if (box.isEmpty()) {
+		return false;
+	}
+
+	// Find the box's screen rectangle and its nearest depth from its corners.
+	glm::vec2 minimum(INFINITY), maximum(-INFINITY);
+	float nearest = INFINITY;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 p(corner & 1 ? box.maximum.x : box.minimum.x, corner & 2 ? box.maximum.y : box.minimum.y,
+			corner & 4 ? box.maximum.z : box.minimum.z);
+		glm::vec4 clip = m_viewProjection * glm::vec4(p, 1);
+		if (behindNearPlane(clip)) {
+			return true;
+		}
+		glm::vec3 window = toWindow(clip, m_width, m_height);
+		minimum = glm::min(minimum, glm::vec2(window.x, window.y));
+		maximum = glm::max(maximum, glm::vec2(window.x, window.y));
+		nearest = std::min(nearest, window.z);
+	}
+	int minX = std::max(0, static_cast<int>(std::floor(minimum.x)));
+	int maxX = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::floor(maximum.x)));
+	int minY = std::max(0, static_cast<int>(std::floor(minimum.y)));
+	int maxY = std::min(static_cast<int>(m_height) - 1, static_cast<int>(std::floor(maximum.y)));
+	if (minX > maxX || minY > maxY) {
+		return true;
+	}
+
+	// The box is hidden only if every pixel of its rectangle has an occluder in front of it.
+	float threshold = nearest - OCCLUSION_DEPTH_BIAS;
+	for (int y = minY; y <= maxY; y++) {
+		const float* row = &m_depth[y * m_width];
+#ifdef OCCLUSION_BUFFER_SSE
+		__m128 xs = _mm_set_ps(3, 2, 1, 0);
+		for (int x = minX & ~3; x <= maxX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), xs);
+			__m128 inRectangle = _mm_and_ps(_mm_cmpge_ps(px, _mm_set1_ps(static_cast<float>(minX))),
+				_mm_cmple_ps(px, _mm_set1_ps(static_cast<float>(maxX))));
+			__m128 behind = _mm_cmpge_ps(_mm_loadu_ps(row + x), _mm_set1_ps(threshold));
+			if (_mm_movemask_ps(_mm_and_ps(inRectangle, behind)) != 0) {
+				return true;
+			}
+		}
+#else
+		for (int x = minX; x <= maxX; x++) {
+			if (row[x] >= threshold) {
+				return true;
+			}
+		}
+#endif
+	}
+	return false;
+}
+
+size_t OcclusionBuffer::width() const {
+	return m_width;
+}
+
+size_t OcclusionBuffer::height() const {
+	return m_height;
+}
+
+float OcclusionBuffer::depth(size_t x, size_t y) const {
+	wait();
+	return m_depth[y * m_width + x];
+}
+
+/**
+ * @brief Appends a PNG chunk: its length, type, data, and the CRC of the type and data.
+ */
+static void writePngChunk(std::ofstream& out, const char* type, const std::vector<uint8_t>& data) {
+	static const std::array<uint32_t, 256> crcTable = [] {
+		std::array<uint32_t, 256> table;
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}();
+	auto writeBigEndian = [&](uint32_t value) {
+		uint8_t bytes[4] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+		out.write(reinterpret_cast<const char*>(bytes), 4);
+	};
+
+	writeBigEndian(static_cast<uint32_t>(data.size()));
+	out.write(type, 4);
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	uint32_t crc = 0xFFFFFFFFu;
+	for (int i = 0; i < 4; i++) {
+		crc = crcTable[(crc ^ uint8_t(type[i])) & 0xFF] ^ (crc >> 8);
+	}
+	for (auto byte : data) {
+		crc = crcTable[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+	}
+	writeBigEndian(crc ^ 0xFFFFFFFFu);
+}
+
+void OcclusionBuffer::saveDebugImage(const std::filesystem::path& path) const {
+	wait();
+
+	// Stretch the occluders' depths over the full gray range; depths crowd towards 1 otherwise.
+	float nearest = 1, farthest = 0;
+	for (float d : m_depth) {
+		if (d < 1) {
+			nearest = std::min(nearest, d);
+			farthest = std::max(farthest, d);
+		}
+	}
+	float range = std::max(farthest - nearest, 1e-6f);
+
+	// Each scanline starts with its filter type (0, none). PNG rows run top to bottom.
+	std::vector<uint8_t> pixels;
+	for (size_t y = m_height; y-- > 0; ) {
+		pixels.push_back(0);
+		for (size_t x = 0; x < m_width; x++) {
+			float d = m_depth[y * m_width + x];
+			pixels.push_back(d >= 1 ? 0 : static_cast<uint8_t>(255 - 223 * (d - nearest) / range));
+		}
+	}
+
+	// A zlib stream of uncompressed deflate blocks, each at most 65535 bytes.
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < pixels.size() || offset == 0; offset += 65535) {
+		size_t length = std::min<size_t>(65535, pixels.size() - offset);
+		bool last = offset + length == pixels.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(uint8_t(length));
+		zlib.push_back(uint8_t(length >> 8));
+		zlib.push_back(uint8_t(~length));
+		zlib.push_back(uint8_t(~length >> 8));
+		zlib.insert(zlib.end(), pixels.begin() + offset, pixels.begin() + offset + length);
+		if (last) {
+			break;
+		}
+	}
+	uint32_t s1 = 1, s2 = 0;
+	for (auto byte : pixels) {
+		s1 = (s1 + byte) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	uint32_t adler = (s2 << 16) | s1;
+	zlib.insert(zlib.end(), { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) });
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error("Could not open " + path.string() + " for writing");
+	}
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.write(reinterpret_cast<const char*>(signature), 8);
+	uint32_t w = static_cast<uint32_t>(m_width), h = static_cast<uint32_t>(m_height);
+	// 8-bit grayscale, default compression, filtering, and no interlacing.
+	writePngChunk(out, "IHDR", { uint8_t(w >> 24), uint8_t(w >> 16), uint8_t(w >> 8), uint8_t(w),
+		uint8_t(h >> 24), uint8_t(h >> 16), uint8_t(h >> 8), uint8_t(h), 8, 0, 0, 0, 0 });
+	writePngChunk(out, "IDAT", zlib);
+	writePngChunk(out, "IEND", {});
+}
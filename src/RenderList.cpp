@@ -0,0 +1,264 @@
+#include "RenderList.h"
+#include "TransformKernel.h"
+#include <algorithm>
+#include <cstring>
+
+RenderList::RenderList() : m_topologyVersion(UINT64_MAX), m_uniformProgram(0) {
+}
+
+void RenderList::compile(const std::vector<Object3D>& roots) {
+	m_nodes.clear();
+	m_parents.clear();
+	m_localMatrices.clear();
+	m_firstDraw.clear();
+	m_drawCount.clear();
+	m_meshes.clear();
+	m_drawNodes.clear();
+	m_textureSets.clear();
+	m_sharedMeshes.clear();
+	m_occluderDraws.clear();
+
+	std::vector<std::vector<uint32_t>> textureSets;
+	for (auto& root : roots) {
+		addNode(root, -1, textureSets);
+	}
+	// Add each level's children after it, so that the nodes of a level are contiguous, and all
+	// their parents are in the level before.
+	m_levelStarts.clear();
+	size_t levelStart = 0;
+	while (levelStart < m_nodes.size()) {
+		size_t levelEnd = m_nodes.size();
+		m_levelStarts.push_back(levelStart);
+		for (size_t node = levelStart; node < levelEnd; node++) {
+			for (size_t i = 0; i < m_nodes[node]->numberOfChildren(); i++) {
+				addNode(m_nodes[node]->getChild(i), static_cast<int32_t>(node), textureSets);
+			}
+		}
+		levelStart = levelEnd;
+	}
+	m_levelStarts.push_back(m_nodes.size());
+	// Every world matrix must be computed on the first update after compiling.
+	m_worldMatrices.assign(m_nodes.size(), glm::mat4(1));
+	m_normalMatrices.assign(m_nodes.size(), glm::mat3(1));
+	m_worldChanged.assign(m_nodes.size(), true);
+	m_ownBounds.assign(m_nodes.size(), BoundingBox());
+	m_subtreeBounds.assign(m_nodes.size(), BoundingBox());
+	m_nodeVisible.assign(m_nodes.size(), true);
+	m_nodeOccluded.assign(m_nodes.size(), false);
+	m_topologyVersion = Object3D::topologyVersion();
+}
+
+void RenderList::addNode(const Object3D& object, int32_t parent, std::vector<std::vector<uint32_t>>& textureSets) {
+	int32_t node = static_cast<int32_t>(m_nodes.size());
+	m_nodes.push_back(&object);
+	m_parents.push_back(parent);
+	m_localMatrices.push_back(object.getLocalMatrix());
+	m_firstDraw.push_back(static_cast<uint32_t>(m_meshes.size()));
+	m_drawCount.push_back(static_cast<uint32_t>(object.getMeshes().size()));
+
+	for (auto& mesh : object.getMeshes()) {
+		std::vector<uint32_t> textureIds;
+		for (auto& texture : mesh->getTextures()) {
+			textureIds.push_back(texture.textureId);
+		}
+		auto set = std::find(textureSets.begin(), textureSets.end(), textureIds);
+		if (set == textureSets.end()) {
+			textureSets.push_back(std::move(textureIds));
+			set = textureSets.end() - 1;
+		}
+
+		if (mesh->occluder()) {
+			m_occluderDraws.push_back(static_cast<uint32_t>(m_meshes.size()));
+		}
+		m_meshes.push_back(mesh.get());
+		m_drawNodes.push_back(static_cast<uint32_t>(node));
+		m_textureSets.push_back(static_cast<uint32_t>(set - textureSets.begin()));
+		m_sharedMeshes.push_back(mesh->shared());
+	}
+}
+
+void RenderList::update(const std::vector<Object3D>& roots) {
+	bool compiled = m_topologyVersion != Object3D::topologyVersion();
+	if (compiled) {
+		compile(roots);
+	}
+
+	// Find the nodes whose world matrix changes: those whose local matrix changed, and the
+	// children of those whose world matrix changed. Parents come before their children, so each
+	// parent's flag is final by the time its children read it.
+	bool anyChanged = false;
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		const glm::mat4& local = m_nodes[i]->getLocalMatrix();
+		bool localChanged = std::memcmp(&local, &m_localMatrices[i], sizeof(glm::mat4)) != 0;
+		if (localChanged) {
+			m_localMatrices[i] = local;
+		}
+		int32_t parent = m_parents[i];
+		m_worldChanged[i] = compiled || localChanged || (parent >= 0 && m_worldChanged[parent]);
+		anyChanged = anyChanged || m_worldChanged[i];
+	}
+	if (!anyChanged) {
+		return;
+	}
+
+	// A root's world matrix is its local matrix.
+	if (m_levelStarts.size() > 1) {
+		for (size_t i = m_levelStarts[0]; i < m_levelStarts[1]; i++) {
+			if (m_worldChanged[i]) {
+				m_worldMatrices[i] = m_localMatrices[i];
+			}
+		}
+	}
+	// Below the roots, multiply each run of changed nodes in a level by their parents in one call.
+	for (size_t level = 1; level + 1 < m_levelStarts.size(); level++) {
+		size_t end = m_levelStarts[level + 1];
+		for (size_t first = m_levelStarts[level]; first < end; ) {
+			if (!m_worldChanged[first]) {
+				first++;
+				continue;
+			}
+			size_t last = first;
+			while (last < end && m_worldChanged[last]) {
+				last++;
+			}
+			propagateTransforms(m_parents.data(), m_localMatrices.data(), m_worldMatrices.data(), first, last);
+			first = last;
+		}
+	}
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		if (m_worldChanged[i]) {
+			m_normalMatrices[i] = Object3D::normalMatrix(m_worldMatrices[i]);
+		}
+	}
+	updateBounds();
+}
+
+void RenderList::updateBounds() {
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		if (m_worldChanged[i]) {
+			m_ownBounds[i] = BoundingBox();
+			for (uint32_t d = m_firstDraw[i]; d < m_firstDraw[i] + m_drawCount[i]; d++) {
+				m_ownBounds[i].add(m_meshes[d]->bounds().transformed(m_worldMatrices[i]));
+			}
+		}
+		m_subtreeBounds[i] = m_ownBounds[i];
+	}
+	// Children come after their parents, so walking backwards finishes each subtree's box before
+	// adding it to its parent's.
+	for (size_t i = m_nodes.size(); i-- > 0; ) {
+		if (m_parents[i] >= 0) {
+			m_subtreeBounds[m_parents[i]].add(m_subtreeBounds[i]);
+		}
+	}
+}
+
+size_t RenderList::nodeCount() const {
+	return m_nodes.size();
+}
+
+size_t RenderList::drawCount() const {
+	return m_meshes.size();
+}
+
+const glm::mat4& RenderList::worldMatrix(size_t node) const {
+	return m_worldMatrices[node];
+}
+
+std::vector<OccluderDraw> RenderList::occluders() const {
+	std::vector<OccluderDraw> draws;
+	for (uint32_t d : m_occluderDraws) {
+		draws.push_back(OccluderDraw{ m_meshes[d]->occluder(), m_worldMatrices[m_drawNodes[d]] });
+	}
+	return draws;
+}
+
+void RenderList::render(ShaderProgram& program, const RenderView& view, const OcclusionBuffer* occlusion) const {
+	renderDraws(program, view, nullptr, occlusion);
+}
+
+void RenderList::render(ShaderProgram& program, const RenderView& view, IndirectRenderer& indirect,
+	const OcclusionBuffer* occlusion) const {
+	renderDraws(program, view, &indirect, occlusion);
+}
+
+void RenderList::renderDraws(ShaderProgram& program, const RenderView& view, IndirectRenderer* indirect,
+	const OcclusionBuffer* occlusion) const {
+	if (m_uniformProgram != program.getId()) {
+		m_normalMatrixUniform = program.getUniform("normalMatrix");
+		m_modelViewProjectionUniform = program.getUniform("modelViewProjection");
+		m_uniformProgram = program.getId();
+	}
+
+	// Test each subtree's bounds against the frustum and then the occluders, unless an ancestor's
+	// subtree has already been culled.
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		int32_t parent = m_parents[i];
+		if (parent >= 0 && !m_nodeVisible[parent]) {
+			m_nodeVisible[i] = false;
+			m_nodeOccluded[i] = m_nodeOccluded[parent];
+			continue;
+		}
+		m_nodeVisible[i] = view.boxVisible(m_subtreeBounds[i]);
+		m_nodeOccluded[i] = false;
+		// A subtree without meshes has nothing to draw, rather than being culled.
+		if (m_subtreeBounds[i].isEmpty()) {
+			continue;
+		}
+		view.stats.nodesTested++;
+		view.stats.nodesCulled += !m_nodeVisible[i];
+		if (m_nodeVisible[i] && occlusion && !occlusion->boxVisible(m_subtreeBounds[i])) {
+			m_nodeVisible[i] = false;
+			m_nodeOccluded[i] = true;
+			view.stats.nodesOccluded++;
+		}
+	}
+
+	InstanceBatcher instances;
+	m_queue.clear();
+	for (size_t d = 0; d < m_meshes.size(); d++) {
+		const Mesh3D& mesh = *m_meshes[d];
+		uint32_t node = m_drawNodes[d];
+		const glm::mat4& world = m_worldMatrices[node];
+		if (!m_nodeVisible[node] || !mesh.inView(view, world)) {
+			if (m_nodeOccluded[node]) {
+				view.stats.trianglesOccluded += mesh.triangleCount(0);
+			}
+			else {
+				view.stats.trianglesCulled += mesh.triangleCount(0);
+			}
+			continue;
+		}
+		if (indirect || m_sharedMeshes[d]) {
+			size_t lod = mesh.selectLod(view, world);
+			if (indirect) {
+				indirect->add(mesh, lod, world, m_nodes[node]->getMaterial());
+			}
+			else {
+				instances.add(mesh, lod, world, m_nodes[node]->getMaterial());
+			}
+			continue;
+		}
+		const BoundingBox& bounds = mesh.bounds();
+		glm::vec3 center = glm::vec3(world * glm::vec4((bounds.minimum + bounds.maximum) * 0.5f, 1));
+		m_queue.push(RenderQueue::key(RenderQueue::Pass::Opaque, program.getId(), m_textureSets[d],
+			mesh.vertexArray(), glm::length(center - view.cameraPosition)), static_cast<uint32_t>(d));
+	}
+
+	// Issue the remaining draws grouped by state, and front to back within each group.
+	view.stats.stateChangesUnsorted += m_queue.stateChanges();
+	m_queue.sort();
+	view.stats.stateChangesSorted += m_queue.stateChanges();
+	// Only set the transform uniforms when the draw's node differs from the last one's.
+	uint32_t modelNode = UINT32_MAX;
+	for (uint32_t d : m_queue.items()) {
+		uint32_t node = m_drawNodes[d];
+		if (modelNode != node) {
+			program.setUniform(m_normalMatrixUniform, m_normalMatrices[node]);
+			program.setUniform(m_modelViewProjectionUniform, view.viewProjection * m_worldMatrices[node]);
+			modelNode = node;
+		}
+		// Only draws that passed inView above were queued.
+		m_meshes[d]->renderInView(program, view, m_worldMatrices[node]);
+	}
+	instances.flush(program, &view);
+}
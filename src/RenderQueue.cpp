@@ -0,0 +1,95 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <utility>
+
+const uint32_t DEPTH_SHIFT = 0;
+const uint32_t VERTEX_ARRAY_SHIFT = DEPTH_SHIFT + RenderQueue::DEPTH_BITS;
+const uint32_t TEXTURE_SET_SHIFT = VERTEX_ARRAY_SHIFT + RenderQueue::VERTEX_ARRAY_BITS;
+const uint32_t PROGRAM_SHIFT = TEXTURE_SET_SHIFT + RenderQueue::TEXTURE_SET_BITS;
+const uint32_t PASS_SHIFT = PROGRAM_SHIFT + RenderQueue::PROGRAM_BITS;
+
+// The radix sort's digits.
+const uint32_t RADIX_BITS = 8;
+const uint32_t RADIX_BUCKETS = 1 << RADIX_BITS;
+
+/**
+ * @brief A value truncated to a field of a key, and moved into place.
+ */
+static uint64_t keyField(uint64_t value, uint32_t bits, uint32_t shift) {
+	return (value & ((uint64_t(1) << bits) - 1)) << shift;
+}
+
+uint64_t RenderQueue::key(Pass pass, uint32_t program, uint32_t textureSet, uint32_t vertexArray, float depth) {
+	// The bits of a non-negative float sort in the same order as its value, so its leading bits
+	// are a depth quantized more finely near the camera than far away. The sign bit is always 0.
+	uint32_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> (31 - DEPTH_BITS);
+	if (pass == Pass::Transparent) {
+		depthBits = ~depthBits;
+	}
+	return keyField(static_cast<uint64_t>(pass), PASS_BITS, PASS_SHIFT)
+		| keyField(program, PROGRAM_BITS, PROGRAM_SHIFT)
+		| keyField(textureSet, TEXTURE_SET_BITS, TEXTURE_SET_SHIFT)
+		| keyField(vertexArray, VERTEX_ARRAY_BITS, VERTEX_ARRAY_SHIFT)
+		| keyField(depthBits, DEPTH_BITS, DEPTH_SHIFT);
+}
+
+void RenderQueue::clear() {
+	m_entries.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t item) {
+	m_entries.push_back(Entry{ key, item });
+}
+
+void RenderQueue::sort() {
+	m_sorted.resize(m_entries.size());
+	for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+		uint32_t counts[RADIX_BUCKETS] = {};
+		for (auto& entry : m_entries) {
+			counts[(entry.key >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+		// Fields that every draw shares, like the pass, leave every entry in one bucket; skip them.
+		if (std::find(std::begin(counts), std::end(counts), m_entries.size()) != std::end(counts)) {
+			continue;
+		}
+
+		// Turn the counts into each bucket's first position, and scatter the entries into place.
+		uint32_t position = 0;
+		for (auto& count : counts) {
+			uint32_t start = position;
+			position += count;
+			count = start;
+		}
+		for (auto& entry : m_entries) {
+			m_sorted[counts[(entry.key >> shift) & (RADIX_BUCKETS - 1)]++] = entry;
+		}
+		m_entries.swap(m_sorted);
+	}
+}
+
+const std::vector<uint32_t>& RenderQueue::items() {
+	m_items.clear();
+	for (auto& entry : m_entries) {
+		m_items.push_back(entry.item);
+	}
+	return m_items;
+}
+
+uint32_t RenderQueue::stateChanges() const {
+	uint32_t changes = 0;
+	for (size_t i = 0; i < m_entries.size(); i++) {
+		uint64_t key = m_entries[i].key;
+		uint64_t previous = i == 0 ? ~key : m_entries[i - 1].key;
+		for (auto [bits, shift] : { std::pair{ PROGRAM_BITS, PROGRAM_SHIFT },
+			std::pair{ TEXTURE_SET_BITS, TEXTURE_SET_SHIFT }, std::pair{ VERTEX_ARRAY_BITS, VERTEX_ARRAY_SHIFT } }) {
+			changes += keyField(key >> shift, bits, 0) != keyField(previous >> shift, bits, 0);
+		}
+	}
+	return changes;
+}
+
+size_t RenderQueue::size() const {
+	return m_entries.size();
+}
@@ -0,0 +1,46 @@
+#include "RenderView.h"
+
+RenderView::RenderView(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition,
+	float viewportHeight, float lodErrorPixels)
+	: view(view), projection(projection), viewProjection(projection * view), cameraPosition(cameraPosition),
+	// projection[1][1] is cot(fovy / 2), which maps a unit height at distance 1 to half the viewport.
+	pixelsPerUnit(projection[1][1] * viewportHeight / 2), lodErrorPixels(lodErrorPixels),
+	cullBackfaces(false) {
+
+	// Extract the frustum planes from the rows of the view-projection matrix (Gribb & Hartmann):
+	// a point is inside when -w <= x, y, z <= w in clip space.
+	auto row = [&](int i) {
+		return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+	for (int axis = 0; axis < 3; axis++) {
+		frustumPlanes[axis * 2] = row(3) + row(axis);
+		frustumPlanes[axis * 2 + 1] = row(3) - row(axis);
+	}
+	for (auto& plane : frustumPlanes) {
+		plane = plane / glm::length(glm::vec3(plane));
+	}
+}
+
+bool RenderView::sphereVisible(const glm::vec3& center, float radius) const {
+	for (auto& plane : frustumPlanes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool RenderView::boxVisible(const BoundingBox& box) const {
+	if (box.isEmpty()) {
+		return false;
+	}
+	// The box is outside a plane if even its corner farthest along the plane's normal is.
+	for (auto& plane : frustumPlanes) {
+		glm::vec3 farthest(plane.x >= 0 ? box.maximum.x : box.minimum.x, plane.y >= 0 ? box.maximum.y : box.minimum.y,
+			plane.z >= 0 ? box.maximum.z : box.minimum.z);
+		if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+#include "Scheduler.h"
+#include <algorithm>
+
+CoroutineQueue::CoroutineQueue() : m_closed(false) {
+}
+
+void CoroutineQueue::post(std::coroutine_handle<> coroutine) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.push_back(coroutine);
+	}
+	m_available.notify_one();
+}
+
+void CoroutineQueue::runPending() {
+	std::deque<std::coroutine_handle<>> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ready.swap(m_pending);
+	}
+	// Coroutines that post themselves back to this queue run on the next call, not this one.
+	for (auto coroutine : ready) {
+		coroutine.resume();
+	}
+}
+
+bool CoroutineQueue::runNext() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_available.wait(lock, [this] { return m_closed || !m_pending.empty(); });
+	if (m_closed) {
+		return false;
+	}
+	auto coroutine = m_pending.front();
+	m_pending.pop_front();
+	lock.unlock();
+	coroutine.resume();
+	return true;
+}
+
+void CoroutineQueue::close() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_available.notify_all();
+}
+
+WorkerPool::WorkerPool() {
+	auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+	for (auto i = 0u; i < threadCount; i++) {
+		m_threads.emplace_back([this] {
+			while (m_queue.runNext()) {
+			}
+		});
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	m_queue.close();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+WorkerPool& WorkerPool::instance() {
+	static WorkerPool pool;
+	return pool;
+}
+
+CoroutineQueue& glThreadQueue() {
+	static CoroutineQueue queue;
+	return queue;
+}
+
+// Static initialization runs on the main thread, before main.
+static const std::thread::id GL_THREAD = std::this_thread::get_id();
+
+bool onGLThread() {
+	return std::this_thread::get_id() == GL_THREAD;
+}
@@ -1,11 +1,12 @@
 #include "ShaderProgram.h"
+#include "GLStateCache.h"
 #include <glad/glad.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
 ShaderProgram::ShaderProgram()
-    : m_programId(-1) {
+    : m_programId(-1), m_lookupCount(0) {
 
 }
 
@@ -88,54 +89,157 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    introspectUniforms();
+}
+
+void ShaderProgram::introspectUniforms()
+{
+    m_uniformLocations.clear();
+
+    int32_t uniformCount = 0;
+    int32_t maxNameLength = 0;
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(maxNameLength, '\0');
+    for (int32_t i = 0; i < uniformCount; i++) {
+        int32_t size;
+        uint32_t type;
+        int32_t nameLength;
+        glGetActiveUniform(m_programId, i, maxNameLength, &nameLength, &size, &type, name.data());
+        std::string uniformName = name.substr(0, nameLength);
+
+        // Members of uniform blocks have no location, and can't be set with glUniform.
+        int32_t location = glGetUniformLocation(m_programId, uniformName.c_str());
+        if (location < 0) {
+            continue;
+        }
+        m_uniformLocations[uniformName] = location;
+
+        // Arrays are reported as "name[0]", but are usually set by their bare name.
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            m_uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
 }
 
 void ShaderProgram::activate()
 {
-    glUseProgram(m_programId);
+    GLStateCache::instance().useProgram(m_programId);
+}
+
+uint32_t ShaderProgram::getId() const
+{
+    return m_programId;
+}
+
+UniformHandle ShaderProgram::getUniform(const std::string& uniformName) const
+{
+    ++m_lookupCount;
+    auto existing = m_uniformLocations.find(uniformName);
+    if (existing == m_uniformLocations.end()) {
+        return UniformHandle{};
+    }
+    return UniformHandle{ existing->second };
+}
+
+uint32_t ShaderProgram::lookupCount() const
+{
+    return m_lookupCount;
+}
+
+void ShaderProgram::resetLookupCount()
+{
+    m_lookupCount = 0;
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, bool value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, int32_t value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, float value)
 {
-    glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), (int)value);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value)
 {
-    glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value)
 {
-    glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniform(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value)
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniform(uniformName), value);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, bool value)
+{
+    glUniform1i(uniform.location, (int32_t)value);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, int32_t value)
+{
+    glUniform1i(uniform.location, value);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, float value)
+{
+    glUniform1f(uniform.location, value);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec2& value)
+{
+    glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec3& value)
+{
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec4& value)
+{
+    glUniform4fv(uniform.location, 1, &value[0]);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat2& value)
+{
+    glUniformMatrix2fv(uniform.location, 1, false, &value[0][0]);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat3& value)
+{
+    glUniformMatrix3fv(uniform.location, 1, false, &value[0][0]);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat4& value)
+{
+    glUniformMatrix4fv(uniform.location, 1, false, &value[0][0]);
 }
@@ -0,0 +1,161 @@
+#include "StaticMerge.h"
+#include <algorithm>
+#include <unordered_map>
+
+/**
+ * @brief A mesh drawn somewhere in a subtree, and its transformation into the subtree root's space.
+ */
+struct PlacedMesh {
+	uint32_t mesh;
+	glm::mat4 transform;
+};
+
+/**
+ * @brief Rebuilds a model's mesh list while nodes are rewritten.
+ */
+class MeshListBuilder {
+	const std::vector<MeshData>& m_original;
+	// Where each original mesh went in the new list, so meshes shared by several nodes stay shared.
+	std::unordered_map<uint32_t, uint32_t> m_kept;
+
+public:
+	std::vector<MeshData> meshes;
+
+	MeshListBuilder(const std::vector<MeshData>& original) : m_original(original) {
+	}
+
+	uint32_t keep(uint32_t original) {
+		auto [entry, inserted] = m_kept.emplace(original, static_cast<uint32_t>(meshes.size()));
+		if (inserted) {
+			meshes.push_back(m_original[original]);
+		}
+		return entry->second;
+	}
+
+	uint32_t add(MeshData&& mesh) {
+		meshes.push_back(std::move(mesh));
+		return static_cast<uint32_t>(meshes.size() - 1);
+	}
+
+	const MeshData& original(uint32_t index) const {
+		return m_original[index];
+	}
+};
+
+bool sameTextures(const std::vector<TextureRef>& a, const std::vector<TextureRef>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].samplerName != b[i].samplerName || a[i].name != b[i].name
+			|| a[i].embeddedTexture != b[i].embeddedTexture) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool isStatic(const NodeData& node, const std::unordered_set<std::string>& animatedNodes) {
+	if (animatedNodes.contains(node.name)) {
+		return false;
+	}
+	for (auto& child : node.children) {
+		if (!isStatic(child, animatedNodes)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void collectMeshes(const NodeData& node, const glm::mat4& transform, std::vector<PlacedMesh>& placed) {
+	for (auto mesh : node.meshes) {
+		placed.push_back(PlacedMesh{ mesh, transform });
+	}
+	for (auto& child : node.children) {
+		collectMeshes(child, transform * child.baseTransform, placed);
+	}
+}
+
+/**
+ * @brief Appends a mesh's geometry to another's, transformed by the given matrix.
+ */
+void appendTransformed(MeshData& target, const MeshData& source, const glm::mat4& transform) {
+	glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(transform));
+	uint32_t firstVertex = static_cast<uint32_t>(target.vertices.size());
+	for (auto& v : source.vertices) {
+		glm::vec4 position = transform * glm::vec4(v.x, v.y, v.z, 1);
+		glm::vec3 normal = normalMatrix * glm::vec3(v.nx, v.ny, v.nz);
+		if (glm::length(normal) > 0) {
+			normal = glm::normalize(normal);
+		}
+		target.vertices.emplace_back(position.x, position.y, position.z, normal.x, normal.y, normal.z, v.u, v.v);
+	}
+
+	// A mirroring transformation reverses the winding of every triangle; swap two corners to undo it.
+	bool mirrored = glm::determinant(glm::mat3(transform)) < 0;
+	for (size_t i = 0; i < source.faces.size(); i += 3) {
+		target.faces.push_back(firstVertex + source.faces[i]);
+		target.faces.push_back(firstVertex + source.faces[i + (mirrored ? 2 : 1)]);
+		target.faces.push_back(firstVertex + source.faces[i + (mirrored ? 1 : 2)]);
+	}
+}
+
+void mergeNode(NodeData& node, MeshListBuilder& builder, const std::unordered_set<std::string>& animatedNodes) {
+	if (!isStatic(node, animatedNodes)) {
+		for (auto& mesh : node.meshes) {
+			mesh = builder.keep(mesh);
+		}
+		for (auto& child : node.children) {
+			mergeNode(child, builder, animatedNodes);
+		}
+		return;
+	}
+
+	std::vector<PlacedMesh> placed;
+	collectMeshes(node, glm::mat4(1), placed);
+
+	// Group the subtree's meshes by texture set, keeping the order they were first drawn in.
+	std::vector<std::vector<PlacedMesh>> groups;
+	for (auto& mesh : placed) {
+		auto group = std::find_if(groups.begin(), groups.end(), [&](auto& g) {
+			return sameTextures(builder.original(g[0].mesh).textures, builder.original(mesh.mesh).textures);
+		});
+		if (group == groups.end()) {
+			groups.push_back({ mesh });
+		}
+		else {
+			group->push_back(mesh);
+		}
+	}
+
+	node.meshes.clear();
+	for (auto& group : groups) {
+		// A mesh that is alone in its group and already in the root's space needs no copy.
+		if (group.size() == 1 && group[0].transform == glm::mat4(1)) {
+			node.meshes.push_back(builder.keep(group[0].mesh));
+			continue;
+		}
+		MeshData merged;
+		merged.name = node.name;
+		merged.textures = builder.original(group[0].mesh).textures;
+		for (auto& mesh : group) {
+			appendTransformed(merged, builder.original(mesh.mesh), mesh.transform);
+		}
+		node.meshes.push_back(builder.add(std::move(merged)));
+	}
+	node.children.clear();
+}
+
+void mergeStaticMeshes(ModelData& model, const std::unordered_set<std::string>& animatedNodes) {
+	MeshListBuilder builder(model.meshes);
+	mergeNode(model.root, builder, animatedNodes);
+	model.meshes = std::move(builder.meshes);
+}
+
+size_t countDrawCalls(const NodeData& node) {
+	size_t count = node.meshes.size();
+	for (auto& child : node.children) {
+		count += countDrawCalls(child);
+	}
+	return count;
+}
@@ -1,6 +1,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "StbImage.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 
@@ -16,6 +17,24 @@ void StbImage::loadFromFile(const std::string& filepath) {
     m_data = std::unique_ptr<unsigned char[]>(data);
 }
 
+void StbImage::loadFromMemory(const unsigned char* data, size_t size, const std::string& name) {
+    unsigned char* pixels = stbi_load_from_memory(data, static_cast<int>(size), &m_width, &m_height, &m_bpp, 4);
+
+    if (pixels == nullptr)
+        throw std::runtime_error("Could not decode image " + name);
+
+    m_data = std::unique_ptr<unsigned char[]>(pixels);
+}
+
+void StbImage::loadFromPixels(const unsigned char* rgba, int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_bpp = 4;
+    size_t size = size_t(width) * height * 4;
+    m_data = std::make_unique<unsigned char[]>(size);
+    std::copy(rgba, rgba + size, m_data.get());
+}
+
 int StbImage::getWidth() const { return m_width; }
 
 int StbImage::getHeight() const { return m_height; }
@@ -0,0 +1,82 @@
+#include "TextureCache.h"
+#include "Hash.h"
+
+TextureCache::TextureCache() : m_dedupByContent(false) {
+}
+
+TextureCache& TextureCache::instance() {
+	static TextureCache cache;
+	return cache;
+}
+
+std::filesystem::path TextureCache::canonicalKey(const std::filesystem::path& path) {
+	std::error_code error;
+	auto canonical = std::filesystem::weakly_canonical(path, error);
+	return error ? path.lexically_normal() : canonical;
+}
+
+void TextureCache::setContentDedup(bool enabled) {
+	m_dedupByContent = enabled;
+}
+
+void TextureCache::purge() {
+	std::erase_if(m_byPath, [](auto& entry) { return entry.second.expired(); });
+	std::erase_if(m_byContent, [](auto& entry) { return entry.second.expired(); });
+}
+
+std::optional<Texture> TextureCache::find(const std::filesystem::path& path, const std::string& samplerName) {
+	auto existing = m_byPath.find(canonicalKey(path));
+	if (existing == m_byPath.end()) {
+		return std::nullopt;
+	}
+	auto storage = existing->second.lock();
+	if (storage == nullptr) {
+		return std::nullopt;
+	}
+	return Texture{ storage->textureId, samplerName, storage };
+}
+
+Texture TextureCache::load(const std::filesystem::path& path, const std::string& samplerName) {
+	if (auto cached = find(path, samplerName)) {
+		return *cached;
+	}
+	StbImage image;
+	image.loadFromFile(path.string());
+	return insert(path, image, samplerName);
+}
+
+Texture TextureCache::insert(const std::filesystem::path& path, const StbImage& image, const std::string& samplerName) {
+	if (auto cached = find(path, samplerName)) {
+		return *cached;
+	}
+	purge();
+
+	auto key = canonicalKey(path);
+	uint64_t contentHash = 0;
+	if (m_dedupByContent) {
+		int32_t size[2] = { image.getWidth(), image.getHeight() };
+		contentHash = fnv1a(size, sizeof(size));
+		contentHash = fnv1a(image.getData(), size_t(size[0]) * size[1] * 4, contentHash);
+
+		auto existing = m_byContent.find(contentHash);
+		if (existing != m_byContent.end()) {
+			if (auto storage = existing->second.lock()) {
+				m_byPath[key] = storage;
+				return Texture{ storage->textureId, samplerName, storage };
+			}
+		}
+	}
+
+	Texture texture = Texture::loadImage(image, samplerName);
+	texture.storage = std::make_shared<const TextureStorage>(texture.textureId);
+	m_byPath[key] = texture.storage;
+	if (m_dedupByContent) {
+		m_byContent[contentHash] = texture.storage;
+	}
+	return texture;
+}
+
+size_t TextureCache::size() {
+	purge();
+	return m_byPath.size();
+}
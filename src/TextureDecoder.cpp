@@ -0,0 +1,114 @@
+#include "TextureDecoder.h"
+#include "BoundedQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include "Scheduler.h"
+#include "Task.h"
+
+// How many decoded images each worker may have waiting for the consumer.
+const size_t DECODED_IMAGES_PER_WORKER = 2;
+
+struct DecodedTexture {
+	size_t index;
+	StbImage image;
+	std::exception_ptr error;
+};
+
+void ImageSource::decode(StbImage& image) const {
+	if (data == nullptr) {
+		image.loadFromFile(path.string());
+	}
+	else if (width > 0) {
+		image.loadFromPixels(data, width, height);
+	}
+	else {
+		image.loadFromMemory(data, size, path.string());
+	}
+}
+
+/**
+ * @brief Decodes one image, capturing any error instead of throwing it.
+ */
+static DecodedTexture decodeSource(const ImageSource& source, size_t index) {
+	DecodedTexture result{ index };
+	try {
+		source.decode(result.image);
+	}
+	catch (...) {
+		result.error = std::current_exception();
+	}
+	return result;
+}
+
+/**
+ * @brief What decodeTextures shares with its helpers on the worker pool. A helper may only start
+ * after decoding is over, so it holds the state by shared_ptr, and only touches the sources that
+ * it claims, whose results the caller waits for.
+ */
+struct DecodeState {
+	const std::vector<ImageSource>& sources;
+	size_t count;
+	std::atomic<size_t> nextSource;
+	BoundedQueue<DecodedTexture> decoded;
+
+	DecodeState(const std::vector<ImageSource>& sources, size_t capacity)
+		: sources(sources), count(sources.size()), nextSource(0), decoded(capacity) {
+	}
+};
+
+/**
+ * @brief Decodes images on a worker thread until there are none left to claim.
+ */
+static Detached decodeOnWorker(std::shared_ptr<DecodeState> state) {
+	co_await resumeOnWorker();
+	for (size_t i = state->nextSource++; i < state->count; i = state->nextSource++) {
+		state->decoded.push(decodeSource(state->sources[i], i));
+	}
+}
+
+void decodeTextures(const std::vector<ImageSource>& sources,
+	const std::function<void(const std::filesystem::path&, StbImage&&)>& consume) {
+	if (sources.empty()) {
+		return;
+	}
+
+	size_t helperCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), sources.size());
+	auto state = std::make_shared<DecodeState>(sources, helperCount * DECODED_IMAGES_PER_WORKER);
+	for (size_t h = 0; h < helperCount; h++) {
+		decodeOnWorker(state);
+	}
+
+	// Consume exactly one result per image, so every helper can finish pushing.
+	std::exception_ptr firstError;
+	size_t consumed = 0;
+	auto consumeResult = [&](DecodedTexture&& result) {
+		consumed++;
+		if (result.error) {
+			firstError = firstError ? firstError : result.error;
+			return;
+		}
+		try {
+			consume(sources[result.index].path, std::move(result.image));
+		}
+		catch (...) {
+			firstError = firstError ? firstError : std::current_exception();
+		}
+	};
+	// Claim images like a helper, and consume whatever the helpers have finished in between.
+	for (size_t i = state->nextSource++; i < state->count; i = state->nextSource++) {
+		consumeResult(decodeSource(sources[i], i));
+		while (auto result = state->decoded.tryPop()) {
+			consumeResult(std::move(*result));
+		}
+	}
+	while (consumed < sources.size()) {
+		consumeResult(state->decoded.pop());
+	}
+
+	if (firstError) {
+		std::rethrow_exception(firstError);
+	}
+}
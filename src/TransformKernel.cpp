@@ -0,0 +1,43 @@
+#include "TransformKernel.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+void propagateTransformsScalar(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+	size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) {
+		worlds[i] = worlds[parents[i]] * locals[i];
+	}
+}
+
+#ifdef TRANSFORM_KERNEL_SSE
+void propagateTransforms(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+	size_t first, size_t last) {
+	// glm matrices are column-major: column j of parent * local is the sum over k of the parent's
+	// column k times local[j][k]. Each column is one SSE register.
+	for (size_t i = first; i < last; i++) {
+		const float* parent = &worlds[parents[i]][0][0];
+		const float* local = &locals[i][0][0];
+		float* world = &worlds[i][0][0];
+		__m128 p0 = _mm_loadu_ps(parent);
+		__m128 p1 = _mm_loadu_ps(parent + 4);
+		__m128 p2 = _mm_loadu_ps(parent + 8);
+		__m128 p3 = _mm_loadu_ps(parent + 12);
+		for (int column = 0; column < 4; column++) {
+			__m128 l = _mm_loadu_ps(local + column * 4);
+			__m128 result = _mm_mul_ps(p0, _mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)));
+			result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1))));
+			result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2))));
+			result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(world + column * 4, result);
+		}
+	}
+}
+#else
+void propagateTransforms(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+	size_t first, size_t last) {
+	propagateTransformsScalar(parents, locals, worlds, first, last);
+}
+#endif
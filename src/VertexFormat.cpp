@@ -0,0 +1,133 @@
+#include "VertexFormat.h"
+#include "Mesh3D.h"
+#include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+#include <cstring>
+
+const float POSITION_TOLERANCE_PER_EDGE = 0.01f;
+const float TEX_COORD_TOLERANCE = 1.0f / 4096;
+
+static_assert(sizeof(PackedVertex3D) == 20, "PackedVertex3D must not contain padding");
+static_assert(sizeof(QuantizedVertex3D) == 16, "QuantizedVertex3D must not contain padding");
+
+uint32_t packNormal(const Vertex3D& v) {
+	return glm::packSnorm3x10_1x2(glm::vec4(v.nx, v.ny, v.nz, 0));
+}
+
+uint32_t packTexCoord(const Vertex3D& v) {
+	return glm::packHalf2x16(glm::vec2(v.u, v.v));
+}
+
+glm::vec3 quantizePosition(const Vertex3D& v, const PositionQuantization& quantization) {
+	return glm::clamp((glm::vec3(v.x, v.y, v.z) - quantization.offset) / quantization.scale, -1.0f, 1.0f);
+}
+
+PositionQuantization positionQuantization(const std::vector<Vertex3D>& vertices) {
+	if (vertices.empty()) {
+		return PositionQuantization{ glm::vec3(1), glm::vec3(0) };
+	}
+	glm::vec3 low(vertices[0].x, vertices[0].y, vertices[0].z);
+	glm::vec3 high = low;
+	for (auto& v : vertices) {
+		low = glm::min(low, glm::vec3(v.x, v.y, v.z));
+		high = glm::max(high, glm::vec3(v.x, v.y, v.z));
+	}
+	// A flat mesh has zero extent along one axis; any nonzero scale will do there.
+	glm::vec3 scale = glm::max((high - low) * 0.5f, glm::vec3(1e-6f));
+	return PositionQuantization{ scale, (low + high) * 0.5f };
+}
+
+VertexFormat chooseVertexFormat(const std::vector<Vertex3D>& vertices, const std::vector<uint32_t>& faces) {
+	for (auto& v : vertices) {
+		glm::vec2 texCoord(v.u, v.v);
+		glm::vec2 decoded = glm::unpackHalf2x16(packTexCoord(v));
+		if (glm::abs(decoded.x - texCoord.x) > TEX_COORD_TOLERANCE
+			|| glm::abs(decoded.y - texCoord.y) > TEX_COORD_TOLERANCE) {
+			return VertexFormat::Float32;
+		}
+	}
+
+	float edgeLength = 0;
+	for (size_t i = 0; i + 2 < faces.size(); i += 3) {
+		for (size_t c = 0; c < 3; c++) {
+			auto& a = vertices[faces[i + c]];
+			auto& b = vertices[faces[i + (c + 1) % 3]];
+			edgeLength += glm::length(glm::vec3(a.x - b.x, a.y - b.y, a.z - b.z));
+		}
+	}
+	if (faces.empty()) {
+		return VertexFormat::PackedAttributes;
+	}
+	float tolerance = POSITION_TOLERANCE_PER_EDGE * edgeLength / faces.size();
+
+	auto quantization = positionQuantization(vertices);
+	for (auto& v : vertices) {
+		glm::vec4 stored = glm::unpackSnorm4x16(glm::packSnorm4x16(glm::vec4(quantizePosition(v, quantization), 0)));
+		glm::vec3 decoded = glm::vec3(stored) * quantization.scale + quantization.offset;
+		if (glm::length(decoded - glm::vec3(v.x, v.y, v.z)) > tolerance) {
+			return VertexFormat::PackedAttributes;
+		}
+	}
+	return VertexFormat::Quantized;
+}
+
+size_t vertexStride(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::PackedAttributes:
+		return sizeof(PackedVertex3D);
+	case VertexFormat::Quantized:
+		return sizeof(QuantizedVertex3D);
+	default:
+		return sizeof(Vertex3D);
+	}
+}
+
+std::vector<unsigned char> encodeVertices(const std::vector<Vertex3D>& vertices, VertexFormat format,
+	const PositionQuantization& quantization) {
+	size_t stride = vertexStride(format);
+	std::vector<unsigned char> bytes(vertices.size() * stride);
+	for (size_t i = 0; i < vertices.size(); i++) {
+		auto& v = vertices[i];
+		unsigned char* out = bytes.data() + i * stride;
+		if (format == VertexFormat::PackedAttributes) {
+			PackedVertex3D packed{ v.x, v.y, v.z, packNormal(v), packTexCoord(v) };
+			std::memcpy(out, &packed, stride);
+		}
+		else if (format == VertexFormat::Quantized) {
+			uint64_t position = glm::packSnorm4x16(glm::vec4(quantizePosition(v, quantization), 0));
+			QuantizedVertex3D quantized;
+			std::memcpy(quantized.position, &position, sizeof(quantized.position));
+			quantized.normal = packNormal(v);
+			quantized.texCoord = packTexCoord(v);
+			std::memcpy(out, &quantized, stride);
+		}
+		else {
+			std::memcpy(out, &v, stride);
+		}
+	}
+	return bytes;
+}
+
+void setVertexAttributes(VertexFormat format) {
+	auto stride = static_cast<int32_t>(vertexStride(format));
+	if (format == VertexFormat::PackedAttributes) {
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)offsetof(PackedVertex3D, x));
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, true, stride, (void*)offsetof(PackedVertex3D, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, stride, (void*)offsetof(PackedVertex3D, texCoord));
+	}
+	else if (format == VertexFormat::Quantized) {
+		glVertexAttribPointer(0, 3, GL_SHORT, true, stride, (void*)offsetof(QuantizedVertex3D, position));
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, true, stride, (void*)offsetof(QuantizedVertex3D, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, stride, (void*)offsetof(QuantizedVertex3D, texCoord));
+	}
+	else {
+		// Each vertex is 3 floats for position, 3 floats for normal vector, then 2 floats for texture coordinate.
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, 0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)12);
+		glVertexAttribPointer(2, 2, GL_FLOAT, false, stride, (void*)24);
+	}
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+}
@@ -4,8 +4,8 @@ The Mesh3D class now initializes a "vertex array" on the GPU to store the vertic
 	and faces of the mesh. To render, the Mesh3D object simply triggers the GPU to draw
 	the stored mesh data.
 We now transform local space vertices to clip space using uniform matrices in the vertex shader.
-	See "simple_perspective.vert" for a vertex shader that uses uniform model, view, and projection
-		matrices to transform to clip space.
+	See "simple_perspective.vert" for a vertex shader that uses a uniform model-view-projection
+		matrix to transform to clip space.
 	See "uniform_color.frag" for a fragment shader that sets a pixel to a uniform parameter.
 */
 #define _USE_MATH_DEFINES
@@ -13,20 +13,38 @@ We now transform local space vertices to clip space using uniform matrices in th
 #include <iostream>
 #include <memory>
 #include <filesystem>
+#include <optional>
+#include <thread>
 #include <math.h>
 
 #include "AssimpImport.h"
 #include "Mesh3D.h"
 #include "Object3D.h"
+#include "InstancedObject.h"
+#include "RenderList.h"
 #include "Animator.h"
+#include "Scheduler.h"
 #include "ShaderProgram.h"
+#include "TextureCache.h"
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+#include "IndirectRenderer.h"
+#include "OcclusionBuffer.h"
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Window.hpp>
 
 struct Scene {
 	ShaderProgram program;
+	// Constructs the equivalent of the program for drawing with an IndirectRenderer, or null if
+	// there is none, in which case the scene is drawn without one even where it is supported.
+	ShaderProgram (*indirectShader)() = nullptr;
+	// The roots of the scene's hierarchies. Call Object3D::hierarchyChanged() after editing the
+	// list once the scene is being rendered.
 	std::vector<Object3D> objects;
 	std::vector<Animator> animators;
+	std::vector<InstancedObject> instancedObjects;
+	// The objects' hierarchies, flattened for rendering.
+	RenderList renderList;
 };
 
 /**
@@ -45,6 +63,23 @@ ShaderProgram phongLightingShader() {
 	return shader;
 }
 
+/**
+ * @brief Constructs a shader program that applies the Phong reflection model, on meshes that are
+ * drawn by an IndirectRenderer. Requires OpenGL 4.3.
+ */
+ShaderProgram phongIndirectShader() {
+	ShaderProgram shader;
+	try {
+		// These shaders are INCOMPLETE.
+		shader.load("shaders/light_indirect.vert", "shaders/lighting.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	return shader;
+}
+
 /**
  * @brief Constructs a shader program that performs texture mapping with no lighting.
  */
@@ -61,19 +96,50 @@ ShaderProgram texturingShader() {
 }
 
 /**
- * @brief Loads an image from the given path into an OpenGL texture.
+ * @brief Constructs a shader program that performs texture mapping with no lighting, on meshes that
+ * are always drawn instanced.
+ */
+ShaderProgram instancedTexturingShader() {
+	ShaderProgram shader;
+	try {
+		shader.load("shaders/texture_instanced.vert", "shaders/texturing.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	return shader;
+}
+
+/**
+ * @brief Constructs a shader program that performs texture mapping with no lighting, on meshes that
+ * are drawn by an IndirectRenderer. Requires OpenGL 4.3.
+ */
+ShaderProgram indirectTexturingShader() {
+	ShaderProgram shader;
+	try {
+		shader.load("shaders/texture_indirect.vert", "shaders/texturing.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	return shader;
+}
+
+/**
+ * @brief Loads an image from the given path into an OpenGL texture, sharing it with any model that
+ * already loaded the same file.
  */
 Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
-	StbImage i;
-	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	return TextureCache::instance().load(path, samplerName);
 }
 
 /*****************************************************************************************
 *  DEMONSTRATION SCENES
 *****************************************************************************************/
 Scene bunny() {
-	Scene scene{ texturingShader() };
+	Scene scene{ texturingShader(), indirectTexturingShader };
 
 	// We assume that (0,0) in texture space is the upper left corner, but some artists use (0,0) in the lower
 	// left corner. In that case, we have to flip the V-coordinate of each UV texture location. The last parameter
@@ -97,13 +163,36 @@ Scene bunny() {
 	return scene;
 }
 
+/**
+ * @brief Demonstrates instanced rendering: a field of 2,500 bunnies, drawn with one draw call per
+ * mesh of the bunny model instead of one per bunny.
+ */
+Scene bunnyField() {
+	Scene scene{ instancedTexturingShader(), indirectTexturingShader };
+
+	auto bunny = assimpLoad("models/bunny_textured.obj", true);
+	bunny.grow(glm::vec3(9, 9, 9));
+	InstancedObject field(bunny);
+	const int rows = 50;
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < rows; column++) {
+			glm::mat4 transform = glm::translate(glm::mat4(1), glm::vec3(column - rows / 2, -1, -row));
+			// Turn each bunny a different way, so the field doesn't look like a grid of clones.
+			transform = glm::rotate(transform, static_cast<float>(row * 7 + column * 13), glm::vec3(0, 1, 0));
+			field.addInstance(transform);
+		}
+	}
+
+	scene.instancedObjects.push_back(std::move(field));
+	return scene;
+}
 
 /**
  * @brief Demonstrates loading a square, oriented as the "floor", with a manually-specified texture
  * that does not come from Assimp.
  */
 Scene marbleSquare() {
-	Scene scene{ texturingShader() };
+	Scene scene{ texturingShader(), indirectTexturingShader };
 
 	std::vector<Texture> textures = {
 		loadTexture("models/White_marble_03/Textures_2K/white_marble_03_2k_baseColor.tga", "baseTexture"),
@@ -122,7 +211,7 @@ Scene marbleSquare() {
  * @brief Loads a cube with a cube map texture.
  */
 Scene cube() {
-	Scene scene{ texturingShader() };
+	Scene scene{ texturingShader(), indirectTexturingShader };
 
 	auto cube = assimpLoad("models/cube.obj", true);
 
@@ -139,20 +228,33 @@ Scene cube() {
 }
 
 /**
- * @brief Constructs a scene of a tiger sitting in a boat, where the tiger is the child object
- * of the boat.
- * @return
+ * @brief Loads a moon from a single-file GLB, whose texture is embedded in the model file.
  */
-Scene lifeOfPi() {
-	// This scene is more complicated; it has child objects, as well as animators.
-	Scene scene{ texturingShader() };
+Scene moon() {
+	Scene scene{ texturingShader(), indirectTexturingShader };
 
-	auto boat = assimpLoad("models/boat/boat.fbx", true);
+	auto moon = assimpLoad("models/moon/Moon_1_3474.glb", true);
+	// The moon is modeled with a radius of 500.
+	moon.grow(glm::vec3(0.003, 0.003, 0.003));
+	scene.objects.push_back(std::move(moon));
+
+	Animator spinMoon;
+	spinMoon.addAnimation(std::make_unique<RotationAnimation>(scene.objects[0], 30.0, glm::vec3(0, 2 * M_PI, 0)));
+	scene.animators.push_back(std::move(spinMoon));
+
+	return scene;
+}
+
+/**
+ * @brief Arranges a boat and a tiger into a scene of a tiger sitting in a boat, where the tiger is
+ * the child object of the boat, and animates them.
+ */
+void arrangeLifeOfPi(Scene& scene, Object3D&& boat, Object3D&& tiger) {
 	boat.move(glm::vec3(0, -0.7, 0));
 	boat.grow(glm::vec3(0.01, 0.01, 0.01));
-	auto tiger = assimpLoad("models/tiger/scene.gltf", true);
 	tiger.move(glm::vec3(0, -5, 10));
-	// Move the tiger to be a child of the boat.
+	// Move the tiger to be a child of the boat. It becomes the boat's last child.
+	size_t tigerIndex = boat.numberOfChildren();
 	boat.addChild(std::move(tiger));
 
 	// Move the boat into the scene list.
@@ -160,21 +262,92 @@ Scene lifeOfPi() {
 
 	// We want these animations to referenced the *moved* objects, which are no longer
 	// in the variables named "tiger" and "boat". "boat" is now in the "objects" list at
-	// index 0, and "tiger" is the index-1 child of the boat.
+	// index 0, and "tiger" is the child of the boat at tigerIndex.
 	Animator animBoat;
 	animBoat.addAnimation(std::make_unique<RotationAnimation>(scene.objects[0], 10, glm::vec3(0, 2 * M_PI, 0)));
 	Animator animTiger;
-	animTiger.addAnimation(std::make_unique<RotationAnimation>(scene.objects[0].getChild(1), 10, glm::vec3(0, 0, 2 * M_PI)));
+	animTiger.addAnimation(std::make_unique<RotationAnimation>(scene.objects[0].getChild(tigerIndex), 10, glm::vec3(0, 0, 2 * M_PI)));
 
 	// The Animators will be destroyed when leaving this function, so we move them into
-	// a list to be returned.
+	// the scene's list.
 	scene.animators.push_back(std::move(animBoat));
 	scene.animators.push_back(std::move(animTiger));
+}
+
+/**
+ * @brief Constructs a scene of a tiger sitting in a boat, where the tiger is the child object
+ * of the boat.
+ * @return
+ */
+Scene lifeOfPi() {
+	// This scene is more complicated; it has child objects, as well as animators.
+	Scene scene{ texturingShader(), indirectTexturingShader };
+
+	// Neither model has any parts that move on their own, so each can be merged into as few
+	// meshes as possible.
+	// The boat is big and solid enough to hide whatever is behind it.
+	ImportOptions options;
+	options.mergeStaticMeshes = true;
+	ImportOptions boatOptions = options;
+	boatOptions.occluder = true;
+	auto boat = assimpLoad("models/boat/boat.fbx", true, boatOptions);
+	auto tiger = assimpLoad("models/tiger/scene.gltf", true, options);
+	arrangeLifeOfPi(scene, std::move(boat), std::move(tiger));
 
 	// Transfer ownership of the objects and animators back to the main.
 	return scene;
 }
 
+/**
+ * @brief Loads the boat and tiger of the lifeOfPi scene in the background, and then replaces the
+ * contents of the given scene with them. Until then, the scene keeps rendering whatever it
+ * already contains as a placeholder.
+ */
+Task<void> lifeOfPiAsync(Scene& scene) {
+	// Start both loads before awaiting either, so the two models load concurrently.
+	ImportOptions options;
+	options.mergeStaticMeshes = true;
+	ImportOptions boatOptions = options;
+	boatOptions.occluder = true;
+	auto boatLoad = loadModelAsync("models/boat/boat.fbx", true, boatOptions);
+	auto tigerLoad = loadModelAsync("models/tiger/scene.gltf", true, options);
+	// Await both loads even if one fails, so that neither task is destroyed while still running.
+	std::optional<Object3D> boat, tiger;
+	std::exception_ptr error;
+	try {
+		boat = co_await boatLoad;
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	try {
+		tiger = co_await tigerLoad;
+	}
+	catch (...) {
+		error = error ? error : std::current_exception();
+	}
+
+	// We resume here on the GL thread, between frames.
+	if (error) {
+		try {
+			std::rethrow_exception(error);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			exit(1);
+		}
+	}
+	scene.objects.clear();
+	scene.animators.clear();
+	arrangeLifeOfPi(scene, std::move(*boat), std::move(*tiger));
+	Object3D::hierarchyChanged();
+	for (auto& anim : scene.animators) {
+		anim.start();
+	}
+	// The placeholder's geometry has just been freed, so this shows how well the arena reuses it.
+	GeometryArena::instance().printStats();
+}
+
 
 
 int main() {
@@ -193,10 +366,19 @@ int main() {
 	gladLoadGL();
 	glEnable(GL_DEPTH_TEST);
 
-	// Inintialize scene objects.
-	auto myScene = lifeOfPi();
-	// You can directly access specific objects in the scene using references.
-	auto& firstObject = myScene.objects[0];
+	// Inintialize scene objects. The spinning cube is a placeholder, which renders while the
+	// lifeOfPi scene loads in the background and then replaces it.
+	auto myScene = cube();
+	auto loading = lifeOfPiAsync(myScene);
+
+	// Where OpenGL 4.3 is available, submit the whole scene with a few multi-draw-indirect calls,
+	// using the scene's shader that reads each draw's transform from a storage buffer.
+	std::unique_ptr<IndirectRenderer> indirect;
+	if (IndirectRenderer::supported() && myScene.indirectShader) {
+		myScene.program = myScene.indirectShader();
+		indirect = std::make_unique<IndirectRenderer>();
+		std::cout << "Submitting with multi-draw-indirect" << std::endl;
+	}
 
 	// Activate the shader program.
 	myScene.program.activate();
@@ -205,9 +387,15 @@ int main() {
 	glm::vec3 cameraPos = glm::vec3(0, 0, 5);
 	glm::mat4 camera = glm::lookAt(cameraPos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 	glm::mat4 perspective = glm::perspective(glm::radians(45.0), static_cast<double>(window.getSize().x) / window.getSize().y, 0.1, 100.0);
-	myScene.program.setUniform("view", camera);
-	myScene.program.setUniform("projection", perspective);
+	// Draws that aren't instanced get their own projection * view * model matrix from the CPU;
+	// instances are placed by the view-projection matrix.
+	myScene.program.setUniform("viewProjection", perspective * camera);
 	myScene.program.setUniform("cameraPos", cameraPos);
+	// Meshes choose their level of detail by how large their simplification error appears on screen.
+	RenderView renderView(camera, perspective, cameraPos, static_cast<float>(window.getSize().y));
+	// The scene's occluders are rasterized on the CPU each frame, at low resolution, to skip
+	// whatever they hide. Press O to save what they covered in the last frame to occlusion.png.
+	OcclusionBuffer occlusion(240, 160);
 
 	// Ready, set, go!
 	bool running = true;
@@ -226,22 +414,57 @@ int main() {
 			if (ev.type == sf::Event::Closed) {
 				running = false;
 			}
+			else if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::O) {
+				occlusion.saveDebugImage("occlusion.png");
+				std::cout << "Saved occlusion.png" << std::endl;
+			}
 		}
 		auto now = c.getElapsedTime();
 		auto diff = now - last;
-		std::cout << 1 / diff.asSeconds() << " FPS " << std::endl;
+		// Report the frame rate, how many uniforms the previous frame looked up by name, how much
+		// geometry it submitted after culling, and how many of its state changes were redundant.
+		std::cout << 1 / diff.asSeconds() << " FPS, "
+			<< myScene.program.lookupCount() << " uniform lookups, "
+			<< renderView.stats.trianglesSubmitted << " triangles in " << renderView.stats.drawCalls << " draws, "
+			<< renderView.stats.nodesCulled << "/" << renderView.stats.nodesTested << " nodes culled ("
+			<< renderView.stats.trianglesCulled << " triangles), "
+			<< renderView.stats.nodesOccluded << " nodes occluded (" << renderView.stats.trianglesOccluded << " triangles), "
+			<< renderView.stats.meshletsCulled << "/" << renderView.stats.meshletsTested << " meshlets culled, "
+			<< renderView.stats.stateChangesUnsorted << " -> " << renderView.stats.stateChangesSorted << " state changes by sorting, "
+			<< GLStateCache::instance().stats().elided << "/"
+			<< GLStateCache::instance().stats().issued + GLStateCache::instance().stats().elided << " state changes elided" << std::endl;
+		myScene.program.resetLookupCount();
+		GLStateCache::instance().resetStats();
+		renderView.stats = RenderStats();
 		last = now;
 
+		// Finish any loading steps that are waiting for the GL thread.
+		glThreadQueue().runPending();
+
 		// Update the scene.
 		for (auto& anim : myScene.animators) {
 			anim.tick(diff.asSeconds());
 		}
 
+		// Rasterize the occluders on the worker thread while the GL thread clears the frame.
+		myScene.renderList.update(myScene.objects);
+		occlusion.rasterizeAsync(perspective * camera, myScene.renderList.occluders());
+
 		// Clear the OpenGL "context".
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Render the scene objects.
-		for (auto& o : myScene.objects) {
-			o.render(myScene.program);
+		if (indirect) {
+			myScene.renderList.render(myScene.program, renderView, *indirect, &occlusion);
+			for (auto& o : myScene.instancedObjects) {
+				o.render(renderView, *indirect);
+			}
+			indirect->flush(myScene.program, &renderView);
+		}
+		else {
+			myScene.renderList.render(myScene.program, renderView, &occlusion);
+			for (auto& o : myScene.instancedObjects) {
+				o.render(myScene.program, renderView);
+			}
 		}
 		window.display();
 
@@ -249,6 +472,11 @@ int main() {
 		
 	}
 
+	// The loads still in flight hold references to myScene, so let them finish before it goes away.
+	while (!loading.isReady()) {
+		glThreadQueue().runPending();
+		std::this_thread::yield();
+	}
 	return 0;
 }
 
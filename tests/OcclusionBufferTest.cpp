@@ -0,0 +1,139 @@
+/**
+Rasterizes known occluders into an OcclusionBuffer and checks the depths it stores, and which boxes
+it reports as visible behind them. Exits with a failure status if any check fails.
+*/
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "OcclusionBuffer.h"
+
+// The view every test rasterizes from: a camera at (0, 0, 5) looking down -Z.
+const glm::vec3 CAMERA_POSITION(0, 0, 5);
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const size_t BUFFER_WIDTH = 240;
+const size_t BUFFER_HEIGHT = 160;
+
+int failures = 0;
+
+void check(bool condition, const char* description) {
+	if (!condition) {
+		std::cout << "FAILED: " << description << std::endl;
+		failures++;
+	}
+}
+
+glm::mat4 viewProjection() {
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+		static_cast<float>(BUFFER_WIDTH) / BUFFER_HEIGHT, NEAR_PLANE, FAR_PLANE);
+	return projection * glm::lookAt(CAMERA_POSITION, glm::vec3(0), glm::vec3(0, 1, 0));
+}
+
+/**
+ * @brief The window-space depth of a point on the camera's axis, the given distance in front of it.
+ */
+float depthAtDistance(float distance) {
+	float ndc = (FAR_PLANE + NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE)
+		- 2 * FAR_PLANE * NEAR_PLANE / ((FAR_PLANE - NEAR_PLANE) * distance);
+	return (ndc + 1) / 2;
+}
+
+/**
+ * @brief A square occluder of the given half-width, facing the camera at the given Z.
+ */
+OccluderDraw square(float halfWidth, float z) {
+	auto mesh = std::make_shared<OccluderMesh>();
+	mesh->positions = { { -halfWidth, -halfWidth, z }, { halfWidth, -halfWidth, z },
+		{ halfWidth, halfWidth, z }, { -halfWidth, halfWidth, z } };
+	mesh->indices = { 0, 1, 2, 0, 2, 3 };
+	return OccluderDraw{ mesh, glm::mat4(1) };
+}
+
+BoundingBox box(const glm::vec3& minimum, const glm::vec3& maximum) {
+	return BoundingBox(minimum, maximum);
+}
+
+/**
+ * @brief A 2x2 square at Z = 0 covers the middle of the view, 5 units in front of the camera.
+ */
+void testSmallOccluder() {
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.rasterizeAsync(viewProjection(), { square(1, 0) });
+
+	// At distance 5 the view is 2 * 5 * tan(22.5 degrees) = 4.14 units tall, so the square spans
+	// 160 * 2 / 4.14 = 77 pixels each way around the center.
+	check(std::abs(buffer.depth(120, 80) - depthAtDistance(5)) < 1e-4f, "the square's depth at the center");
+	check(std::abs(buffer.depth(150, 110) - depthAtDistance(5)) < 1e-4f, "the square's depth near its corner");
+	check(buffer.depth(165, 80) == 1.0f, "no depth right of the square");
+	check(buffer.depth(120, 125) == 1.0f, "no depth above the square");
+	check(buffer.depth(0, 0) == 1.0f, "no depth in the buffer's corner");
+
+	check(!buffer.boxVisible(box({ -0.5f, -0.5f, -3 }, { 0.5f, 0.5f, -2 })), "a box behind the square is hidden");
+	check(buffer.boxVisible(box({ -0.5f, -0.5f, 1 }, { 0.5f, 0.5f, 2 })), "a box in front of the square is visible");
+	check(buffer.boxVisible(box({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f })),
+		"a box through the square is visible");
+	check(buffer.boxVisible(box({ 1.5f, -0.5f, -3 }, { 2.5f, 0.5f, -2 })), "a box beside the square is visible");
+	check(buffer.boxVisible(box({ -3, -0.5f, -3 }, { 3, 0.5f, -2 })),
+		"a box wider than the square is visible");
+	check(buffer.boxVisible(box({ 2, -0.5f, -3 }, { 20, 0.5f, -2 })),
+		"a box partly off-screen and beside the square is visible");
+	check(buffer.boxVisible(box({ -0.5f, -0.5f, 4.5f }, { 0.5f, 0.5f, 6 })),
+		"a box crossing the near plane is visible");
+	check(!buffer.boxVisible(BoundingBox()), "an empty box is hidden");
+}
+
+/**
+ * @brief A square at Z = 0 that covers the whole view, so that only what crosses it, or is in
+ * front of it, may be visible.
+ */
+void testScreenCoveringOccluder() {
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.rasterize(viewProjection(), { square(50, 0) });
+
+	bool covered = true;
+	for (size_t y = 0; y < buffer.height(); y++) {
+		for (size_t x = 0; x < buffer.width(); x++) {
+			covered = covered && std::abs(buffer.depth(x, y) - depthAtDistance(5)) < 1e-4f;
+		}
+	}
+	check(covered, "the covering square's depth at every pixel");
+
+	check(!buffer.boxVisible(box({ 2, -0.5f, -3 }, { 20, 0.5f, -2 })),
+		"a box partly off-screen behind the covering square is hidden");
+	check(!buffer.boxVisible(box({ -100, -100, -50 }, { 100, 100, -40 })),
+		"a box around the whole view behind the covering square is hidden");
+	check(buffer.boxVisible(box({ -0.5f, -0.5f, 4.5f }, { 0.5f, 0.5f, 6 })),
+		"a box crossing the near plane in front of the covering square is visible");
+	check(buffer.boxVisible(box({ -0.5f, -0.5f, -50 }, { 0.5f, 0.5f, 6 })),
+		"a box from behind the covering square through the near plane is visible");
+	check(buffer.boxVisible(box({ 100, -0.5f, -3 }, { 120, 0.5f, -2 })),
+		"a box entirely off-screen is visible");
+}
+
+/**
+ * @brief Two overlapping occluders: the nearer one's depth wins where they overlap.
+ */
+void testOverlappingOccluders() {
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.rasterize(viewProjection(), { square(1, 0), square(0.25f, 1) });
+
+	check(std::abs(buffer.depth(120, 80) - depthAtDistance(4)) < 1e-4f, "the nearer square's depth where they overlap");
+	check(std::abs(buffer.depth(150, 80) - depthAtDistance(5)) < 1e-4f, "the farther square's depth elsewhere");
+	check(!buffer.boxVisible(box({ -0.1f, -0.1f, 0.3f }, { 0.1f, 0.1f, 0.6f })),
+		"a box between the squares, behind the nearer one, is hidden");
+	check(buffer.boxVisible(box({ 0.5f, -0.1f, 0.3f }, { 0.7f, 0.1f, 0.6f })),
+		"a box in front of the farther square, beside the nearer one, is visible");
+}
+
+int main() {
+	testSmallOccluder();
+	testScreenCoveringOccluder();
+	testOverlappingOccluders();
+	if (failures > 0) {
+		std::cout << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}